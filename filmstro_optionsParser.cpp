@@ -40,184 +40,4561 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 
+#if FILMSTRO_OPTIONS_PARSER_USDT && JUCE_LINUX
+ #include <sys/sdt.h>
+ #define FILMSTRO_PROBE1(name, a)       DTRACE_PROBE1 (filmstro_options, name, a)
+ #define FILMSTRO_PROBE2(name, a, b)    DTRACE_PROBE2 (filmstro_options, name, a, b)
+#else
+ #define FILMSTRO_PROBE1(name, a)
+ #define FILMSTRO_PROBE2(name, a, b)
+#endif
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ #include <poll.h>
+ #include <unistd.h>
+ #include <cerrno>
+ #define FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS 1
+#else
+ #define FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS 0
+#endif
+
+namespace
+{
+    struct SipHashKey {
+        juce::uint64 k0;
+        juce::uint64 k1;
+    };
+
+    /** The secret is created once per process, so hashes can't be predicted from outside */
+    const SipHashKey& getProcessHashKey ()
+    {
+        static const SipHashKey key = [] {
+            juce::Random random;
+            random.setSeedRandomly();
+            SipHashKey k;
+            k.k0 = (juce::uint64) random.nextInt64() ^ (juce::uint64) juce::Time::getHighResolutionTicks();
+            k.k1 = (juce::uint64) random.nextInt64() ^ (juce::uint64) (juce::pointer_sized_int) &random;
+            return k;
+        }();
+        return key;
+    }
+
+    inline juce::uint64 rotateLeft (const juce::uint64 x, const int bits)
+    {
+        return (x << bits) | (x >> (64 - bits));
+    }
+
+    inline void sipRound (juce::uint64& v0, juce::uint64& v1, juce::uint64& v2, juce::uint64& v3)
+    {
+        v0 += v1; v1 = rotateLeft (v1, 13); v1 ^= v0; v0 = rotateLeft (v0, 32);
+        v2 += v3; v3 = rotateLeft (v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotateLeft (v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotateLeft (v1, 17); v1 ^= v2; v2 = rotateLeft (v2, 32);
+    }
+
+    juce::uint64 sipHash24 (const SipHashKey& key, const char* data, const size_t numBytes)
+    {
+        juce::uint64 v0 = key.k0 ^ 0x736f6d6570736575ULL;
+        juce::uint64 v1 = key.k1 ^ 0x646f72616e646f6dULL;
+        juce::uint64 v2 = key.k0 ^ 0x6c7967656e657261ULL;
+        juce::uint64 v3 = key.k1 ^ 0x7465646279746573ULL;
+
+        const juce::uint8* bytes = reinterpret_cast<const juce::uint8*> (data);
+        const size_t numBlocks = numBytes / 8;
+
+        for (size_t block = 0; block < numBlocks; ++block) {
+            juce::uint64 m = 0;
+            for (int i = 7; i >= 0; --i)
+                m = (m << 8) | bytes [block * 8 + (size_t) i];
+
+            v3 ^= m;
+            sipRound (v0, v1, v2, v3);
+            sipRound (v0, v1, v2, v3);
+            v0 ^= m;
+        }
+
+        juce::uint64 last = ((juce::uint64) numBytes) << 56;
+        for (size_t i = numBlocks * 8; i < numBytes; ++i)
+            last |= ((juce::uint64) bytes [i]) << (8 * (i - numBlocks * 8));
+
+        v3 ^= last;
+        sipRound (v0, v1, v2, v3);
+        sipRound (v0, v1, v2, v3);
+        v0 ^= last;
+
+        v2 ^= 0xff;
+        for (int i = 0; i < 4; ++i)
+            sipRound (v0, v1, v2, v3);
+
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    /**
+     Reads a stream on a separate thread into a bounded ring buffer, so e.g. decompression
+     and parsing run in parallel while the memory used stays constant.
+     */
+    class PipelinedInputStream : public juce::InputStream,
+                                 private juce::Thread
+    {
+    public:
+        PipelinedInputStream (juce::InputStream* sourceToOwn, const int bufferSize)
+          : juce::Thread    ("OptionsParser reader"),
+            source          (sourceToOwn),
+            fifo            (bufferSize),
+            buffer          ((size_t) bufferSize),
+            sourceExhausted (false),
+            position        (0)
+        {
+            startThread();
+        }
+
+        ~PipelinedInputStream ()
+        {
+            // the reader stops after the current read of the source. It must not be killed
+            // while it is in there, it would leave the source and its locks in a broken state
+            signalThreadShouldExit();
+            spaceAvailable.signal();
+            stopThread (-1);
+        }
+
+        juce::int64 getTotalLength () override            { return -1; }
+        juce::int64 getPosition () override               { return position; }
+        bool setPosition (juce::int64 newPosition) override { return newPosition == position; }
+
+        bool isExhausted () override
+        {
+            return sourceExhausted.load() && fifo.getNumReady() == 0;
+        }
+
+        int read (void* destBuffer, int maxBytesToRead) override
+        {
+            char* dest = static_cast<char*> (destBuffer);
+            int numRead = 0;
+
+            while (numRead < maxBytesToRead) {
+                const int numReady = fifo.getNumReady();
+                if (numReady == 0) {
+                    if (numRead > 0)
+                        break;
+
+                    // the writer might have added data before setting the flag
+                    if (sourceExhausted.load() && fifo.getNumReady() == 0)
+                        break;
+
+                    dataAvailable.wait (100);
+                    continue;
+                }
+
+                int start1, size1, start2, size2;
+                fifo.prepareToRead (juce::jmin (numReady, maxBytesToRead - numRead), start1, size1, start2, size2);
+                if (size1 > 0) memcpy (dest + numRead, buffer + start1, (size_t) size1);
+                if (size2 > 0) memcpy (dest + numRead + size1, buffer + start2, (size_t) size2);
+                fifo.finishedRead (size1 + size2);
+                numRead += size1 + size2;
+                spaceAvailable.signal();
+            }
+
+            position += numRead;
+            return numRead;
+        }
+
+    private:
+        void run () override
+        {
+            while (! threadShouldExit()) {
+                int start1, size1, start2, size2;
+                fifo.prepareToWrite (fifo.getFreeSpace(), start1, size1, start2, size2);
+                if (size1 + size2 == 0) {
+                    spaceAvailable.wait (100);
+                    continue;
+                }
+
+                const int start   = size1 > 0 ? start1 : start2;
+                const int size    = size1 > 0 ? size1  : size2;
+                const int numRead = source->read (buffer + start, size);
+                if (numRead <= 0)
+                    break;
+
+                fifo.finishedWrite (numRead);
+                dataAvailable.signal();
+            }
+
+            sourceExhausted = true;
+            dataAvailable.signal();
+        }
+
+        std::unique_ptr<juce::InputStream> source;
+        juce::AbstractFifo                 fifo;
+        juce::HeapBlock<char>              buffer;
+        juce::WaitableEvent                dataAvailable;
+        juce::WaitableEvent                spaceAvailable;
+        std::atomic<bool>                  sourceExhausted;
+        juce::int64                        position;
+    };
+
+    /** Longest line readLines accepts, so a stream without line breaks isn't buffered whole */
+    const size_t maxConfigLineLength = 1 << 20;
+
+    /** Calls callback for each line in the stream, reading it in chunks. Returns false and stops
+        reading, if a line is longer than maxConfigLineLength */
+    template <typename Callback>
+    bool readLines (juce::InputStream& stream, Callback&& callback)
+    {
+        const int chunkSize = 65536;
+        juce::HeapBlock<char>    chunk ((size_t) chunkSize);
+        juce::MemoryOutputStream pending;
+
+        for (;;) {
+            const int numRead = stream.read (chunk, chunkSize);
+            if (numRead <= 0)
+                break;
+
+            int start = 0;
+            for (int i = 0; i < numRead; ++i) {
+                if (chunk [i] != '\n')
+                    continue;
+
+                if (pending.getDataSize() + (size_t) (i - start) > maxConfigLineLength)
+                    return false;
+
+                if (pending.getDataSize() > 0) {
+                    pending.write (chunk + start, (size_t) (i - start));
+                    callback (pending.toUTF8());
+                    pending.reset();
+                }
+                else {
+                    callback (juce::String::fromUTF8 (chunk + start, i - start));
+                }
+                start = i + 1;
+            }
+            if (pending.getDataSize() + (size_t) (numRead - start) > maxConfigLineLength)
+                return false;
+
+            pending.write (chunk + start, (size_t) (numRead - start));
+        }
+
+        if (pending.getDataSize() > 0)
+            callback (pending.toUTF8());
+
+        return true;
+    }
+
+    /** FNV-1a, used for hashes that are persisted and must not change between processes */
+    juce::uint64 stableHash (const void* data, const size_t numBytes,
+                             juce::uint64 hash = 14695981039346656037ULL)
+    {
+        const juce::uint8* bytes = static_cast<const juce::uint8*> (data);
+        for (size_t i = 0; i < numBytes; ++i) {
+            hash ^= bytes [i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    juce::uint64 stableHash (const juce::String& text, const juce::uint64 hash)
+    {
+        // includes the terminating zero, so "ab" + "c" differs from "a" + "bc"
+        return stableHash (text.toRawUTF8(), text.getNumBytesAsUTF8() + 1, hash);
+    }
+
+    /** Type tags to store a var in binary form */
+    enum BinaryValueType {
+        BinaryVoid = 0,
+        BinaryInt,
+        BinaryInt64,
+        BinaryDouble,
+        BinaryBool,
+        BinaryString
+    };
+
+    /** Writes into a fixed buffer with the interface of an OutputStream. It counts the bytes that
+        didn't fit, so the caller can learn the size needed */
+    class BufferWriter {
+    public:
+        BufferWriter (char* b, const size_t s)
+          : buffer   (b),
+            size     (s),
+            position (0)
+        {}
+
+        bool write (const void* data, const size_t numBytes)
+        {
+            if (position < size)
+                memcpy (buffer + position, data, juce::jmin (numBytes, size - position));
+            position += numBytes;
+            return position <= size;
+        }
+
+        bool writeByte (const char byte)        { return write (&byte, 1); }
+
+        bool writeInt (const int value)
+        {
+            const juce::uint32 v = juce::ByteOrder::swapIfBigEndian ((juce::uint32) value);
+            return write (&v, sizeof (v));
+        }
+
+        bool writeInt64 (const juce::int64 value)
+        {
+            const juce::uint64 v = juce::ByteOrder::swapIfBigEndian ((juce::uint64) value);
+            return write (&v, sizeof (v));
+        }
+
+        bool writeDouble (const double value)
+        {
+            juce::int64 bits;
+            memcpy (&bits, &value, sizeof (bits));
+            return writeInt64 (bits);
+        }
+
+        size_t getPosition () const noexcept { return position; }
+
+    private:
+        char*        buffer;
+        size_t       size;
+        size_t       position;
+    };
+
+    /** Wraps an OutputStream and remembers, if any write failed */
+    class StreamWriter {
+    public:
+        StreamWriter (juce::OutputStream& s)
+          : stream (s),
+            ok     (true)
+        {}
+
+        bool write (const void* data, const size_t numBytes) { return ok = stream.write (data, numBytes) && ok; }
+        bool writeByte (const char byte)             { return ok = stream.writeByte (byte) && ok; }
+        bool writeInt (const int value)              { return ok = stream.writeInt (value) && ok; }
+        bool writeInt64 (const juce::int64 value)    { return ok = stream.writeInt64 (value) && ok; }
+        bool writeDouble (const double value)        { return ok = stream.writeDouble (value) && ok; }
+
+        bool wasOk () const noexcept { return ok; }
+
+    private:
+        juce::OutputStream& stream;
+        bool                ok;
+    };
+
+    template <typename Writer>
+    void writeText (Writer& writer, const char* text)
+    {
+        writer.write (text, strlen (text));
+    }
+
+    /** Writes a JSON string literal, escaping quotes, backslashes and control characters */
+    template <typename Writer>
+    void writeJsonString (Writer& writer, const juce::String& text)
+    {
+        const char* bytes = text.toRawUTF8();
+        const size_t numBytes = text.getNumBytesAsUTF8();
+
+        writer.writeByte ('"');
+        size_t start = 0;
+        for (size_t i = 0; i < numBytes; ++i) {
+            const unsigned char c = (unsigned char) bytes [i];
+            if (c >= 0x20 && c != '"' && c != '\\')
+                continue;
+
+            writer.write (bytes + start, i - start);
+            start = i + 1;
+
+            char escaped [8];
+            switch (c) {
+                case '"':  writeText (writer, "\\\""); break;
+                case '\\': writeText (writer, "\\\\"); break;
+                case '\n': writeText (writer, "\\n"); break;
+                case '\r': writeText (writer, "\\r"); break;
+                case '\t': writeText (writer, "\\t"); break;
+                default:
+                    snprintf (escaped, sizeof (escaped), "\\u%04x", (unsigned int) c);
+                    writeText (writer, escaped);
+            }
+        }
+        writer.write (bytes + start, numBytes - start);
+        writer.writeByte ('"');
+    }
+
+    template <typename Writer>
+    void writeJsonValue (Writer& writer, const juce::var& value)
+    {
+        char number [32];
+        if (value.isVoid()) {
+            writeText (writer, "null");
+        }
+        else if (value.isBool()) {
+            writeText (writer, (bool) value ? "true" : "false");
+        }
+        else if (value.isInt()) {
+            snprintf (number, sizeof (number), "%d", (int) value);
+            writeText (writer, number);
+        }
+        else if (value.isInt64()) {
+            snprintf (number, sizeof (number), "%lld", (long long) (juce::int64) value);
+            writeText (writer, number);
+        }
+        else if (value.isDouble()) {
+            const double d = value;
+            // JSON has no representation for nan and infinity
+            if (juce::juce_isfinite (d)) {
+                snprintf (number, sizeof (number), "%.17g", d);
+                writeText (writer, number);
+            }
+            else {
+                writeText (writer, "null");
+            }
+        }
+        else {
+            writeJsonString (writer, value.toString());
+        }
+    }
+
+    const char* getSourceName (const OptionsParser::ValueSource source)
+    {
+        switch (source) {
+            case OptionsParser::SourceConfig:    return "config";
+            case OptionsParser::SourceArguments: return "arguments";
+            default:                             return "default";
+        }
+    }
+
+    const char* configValuesMagic = "OPTVALS1";
+
+    template <typename Stream>
+    void writeBinaryValue (Stream& stream, const juce::var& value)
+    {
+        if (value.isVoid()) {
+            stream.writeByte (BinaryVoid);
+        }
+        else if (value.isBool()) {
+            stream.writeByte (BinaryBool);
+            stream.writeByte ((bool) value ? 1 : 0);
+        }
+        else if (value.isInt()) {
+            stream.writeByte (BinaryInt);
+            stream.writeInt ((int) value);
+        }
+        else if (value.isInt64()) {
+            stream.writeByte (BinaryInt64);
+            stream.writeInt64 ((juce::int64) value);
+        }
+        else if (value.isDouble()) {
+            stream.writeByte (BinaryDouble);
+            stream.writeDouble ((double) value);
+        }
+        else {
+            const juce::String text = value.toString();
+            const size_t numBytes = text.getNumBytesAsUTF8();
+            stream.writeByte (BinaryString);
+            stream.writeInt ((int) numBytes);
+            stream.write (text.toRawUTF8(), numBytes);
+        }
+    }
+
+    /**
+     An event based JSON reader. It reads from memory or pulls chunks from a stream and calls
+     the handler for each token, without building a tree. Strings and numbers are passed as
+     UTF-8 bytes from a reused buffer, which is zero terminated.
+     */
+    class JsonReader {
+    public:
+        JsonReader (const void* d, const size_t s)
+          : data       (static_cast<const char*> (d)),
+            size       (s),
+            position   (0),
+            stream     (nullptr),
+            lineNumber (1),
+            error      (nullptr)
+        {}
+
+        JsonReader (juce::InputStream& s)
+          : data       (nullptr),
+            size       (0),
+            position   (0),
+            stream     (&s),
+            lineNumber (1),
+            error      (nullptr)
+        {
+            buffer.malloc (bufferSize);
+        }
+
+        template <typename Handler>
+        bool read (Handler& handler)
+        {
+            skipWhitespace();
+            if (! readValue (handler, 0))
+                return false;
+
+            skipWhitespace();
+            return peek() < 0 || fail ("Unexpected text after the JSON value");
+        }
+
+        int          getLineNumber () const noexcept { return lineNumber; }
+        const char*  getError () const noexcept      { return error; }
+
+    private:
+        enum {
+            bufferSize = 1 << 16,
+            maxDepth   = 64
+        };
+
+        int peek ()
+        {
+            if (position == size && ! refill())
+                return -1;
+            return (unsigned char) data [position];
+        }
+
+        int next ()
+        {
+            const int c = peek();
+            if (c >= 0) {
+                ++position;
+                if (c == '\n') ++lineNumber;
+            }
+            return c;
+        }
+
+        bool refill ()
+        {
+            if (stream == nullptr)
+                return false;
+
+            const int numRead = stream->read (buffer, bufferSize);
+            if (numRead <= 0)
+                return false;
+
+            data     = buffer;
+            size     = (size_t) numRead;
+            position = 0;
+            return true;
+        }
+
+        void skipWhitespace ()
+        {
+            for (int c = peek(); c == ' ' || c == '\t' || c == '\r' || c == '\n'; c = peek())
+                next();
+        }
+
+        bool fail (const char* message)
+        {
+            error = message;
+            return false;
+        }
+
+        bool expect (const char* literal)
+        {
+            for (; *literal != 0; ++literal)
+                if (next() != *literal)
+                    return fail ("Invalid literal");
+            return true;
+        }
+
+        template <typename Handler>
+        bool readValue (Handler& handler, const int depth)
+        {
+            switch (peek()) {
+                case '{': return readObject (handler, depth + 1);
+                case '[': return readArray (handler, depth + 1);
+                case '"':
+                    if (! readString()) return false;
+                    handler.string (getScratch(), getScratchSize());
+                    return true;
+                case 't':
+                    if (! expect ("true")) return false;
+                    handler.boolean (true);
+                    return true;
+                case 'f':
+                    if (! expect ("false")) return false;
+                    handler.boolean (false);
+                    return true;
+                case 'n':
+                    if (! expect ("null")) return false;
+                    handler.null();
+                    return true;
+                default:
+                    if (! readNumber()) return false;
+                    handler.number (getScratch(), getScratchSize());
+                    return true;
+            }
+        }
+
+        template <typename Handler>
+        bool readObject (Handler& handler, const int depth)
+        {
+            if (depth > maxDepth)
+                return fail ("Nesting too deep");
+
+            next();
+            handler.startObject();
+            skipWhitespace();
+            if (peek() == '}') {
+                next();
+                handler.endObject();
+                return true;
+            }
+
+            for (;;) {
+                if (peek() != '"')
+                    return fail ("Expected a key");
+                if (! readString())
+                    return false;
+                handler.key (getScratch(), getScratchSize());
+
+                skipWhitespace();
+                if (next() != ':')
+                    return fail ("Expected : after a key");
+                skipWhitespace();
+                if (! readValue (handler, depth))
+                    return false;
+
+                skipWhitespace();
+                const int c = next();
+                if (c == '}')
+                    break;
+                if (c != ',')
+                    return fail ("Expected , or } in an object");
+                skipWhitespace();
+            }
+
+            handler.endObject();
+            return true;
+        }
+
+        template <typename Handler>
+        bool readArray (Handler& handler, const int depth)
+        {
+            if (depth > maxDepth)
+                return fail ("Nesting too deep");
+
+            next();
+            handler.startArray();
+            skipWhitespace();
+            if (peek() == ']') {
+                next();
+                handler.endArray();
+                return true;
+            }
+
+            for (;;) {
+                if (! readValue (handler, depth))
+                    return false;
+
+                skipWhitespace();
+                const int c = next();
+                if (c == ']')
+                    break;
+                if (c != ',')
+                    return fail ("Expected , or ] in an array");
+                skipWhitespace();
+            }
+
+            handler.endArray();
+            return true;
+        }
+
+        bool readString ()
+        {
+            next();
+            scratch.reset();
+
+            for (;;) {
+                // copy runs of plain characters at once
+                const size_t start = position;
+                while (position < size && data [position] != '"' && data [position] != '\\'
+                       && (unsigned char) data [position] >= 0x20)
+                    ++position;
+                scratch.write (data + start, position - start);
+
+                const int c = next();
+                if (c == '"')
+                    break;
+                if (c == '\\') {
+                    if (! readEscape())
+                        return false;
+                }
+                else if (c < 0) {
+                    return fail ("Unterminated string");
+                }
+                else if (c < 0x20) {
+                    return fail ("Control character in a string");
+                }
+                else {
+                    scratch.writeByte ((char) c);
+                }
+            }
+
+            scratch.writeByte (0);
+            return true;
+        }
+
+        bool readEscape ()
+        {
+            const int c = next();
+            switch (c) {
+                case '"': case '\\': case '/': scratch.writeByte ((char) c); return true;
+                case 'b': scratch.writeByte ('\b'); return true;
+                case 'f': scratch.writeByte ('\f'); return true;
+                case 'n': scratch.writeByte ('\n'); return true;
+                case 'r': scratch.writeByte ('\r'); return true;
+                case 't': scratch.writeByte ('\t'); return true;
+                case 'u': break;
+                default:  return fail ("Invalid escape in a string");
+            }
+
+            juce::uint32 codePoint = 0;
+            if (! readHex (codePoint))
+                return false;
+
+            // characters outside the basic plane are written as surrogate pair
+            if (codePoint >= 0xd800 && codePoint < 0xdc00) {
+                juce::uint32 low = 0;
+                if (next() != '\\' || next() != 'u' || ! readHex (low) || low < 0xdc00 || low >= 0xe000)
+                    return fail ("Invalid surrogate pair in a string");
+                codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+            }
+
+            char utf8 [4];
+            const size_t numBytes = juce::CharPointer_UTF8::getBytesRequiredFor ((juce::juce_wchar) codePoint);
+            juce::CharPointer_UTF8 (utf8).write ((juce::juce_wchar) codePoint);
+            scratch.write (utf8, numBytes);
+            return true;
+        }
+
+        bool readHex (juce::uint32& value)
+        {
+            for (int i = 0; i < 4; ++i) {
+                const int digit = juce::CharacterFunctions::getHexDigitValue ((juce::juce_wchar) next());
+                if (digit < 0)
+                    return fail ("Invalid \\u escape in a string");
+                value = (value << 4) | (juce::uint32) digit;
+            }
+            return true;
+        }
+
+        /** Follows the JSON grammar: -? (0 | [1-9][0-9]*) (.[0-9]+)? ([eE][+-]?[0-9]+)? */
+        bool readNumber ()
+        {
+            scratch.reset();
+            const int first = peek();
+            if (first != '-' && (first < '0' || first > '9'))
+                return fail ("Unexpected character");
+
+            if (first == '-')
+                scratch.writeByte ((char) next());
+
+            if (peek() == '0') {
+                scratch.writeByte ((char) next());
+            }
+            else if (! readDigits()) {
+                return fail ("Invalid number");
+            }
+
+            if (peek() == '.') {
+                scratch.writeByte ((char) next());
+                if (! readDigits())
+                    return fail ("Invalid number");
+            }
+
+            if (peek() == 'e' || peek() == 'E') {
+                scratch.writeByte ((char) next());
+                if (peek() == '+' || peek() == '-')
+                    scratch.writeByte ((char) next());
+                if (! readDigits())
+                    return fail ("Invalid number");
+            }
+
+            // e.g. "1-2" or "01"
+            const int c = peek();
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+                return fail ("Invalid number");
+
+            scratch.writeByte (0);
+            return true;
+        }
+
+        /** Appends one or more digits to the scratch, returns false if there is none */
+        bool readDigits ()
+        {
+            int numDigits = 0;
+            for (int c = peek(); c >= '0' && c <= '9'; c = peek(), ++numDigits)
+                scratch.writeByte ((char) next());
+            return numDigits > 0;
+        }
+
+        const char* getScratch () const      { return static_cast<const char*> (scratch.getData()); }
+        size_t      getScratchSize () const  { return scratch.getDataSize() - 1; }
+
+        const char*              data;
+        size_t                   size;
+        size_t                   position;
+        juce::InputStream*       stream;
+        juce::HeapBlock<char>    buffer;
+        juce::MemoryOutputStream scratch;
+        int                      lineNumber;
+        const char*              error;
+    };
+
+    /** Reads little endian values from untrusted memory with bounds checks */
+    class BinaryReader {
+    public:
+        BinaryReader (const void* d, const size_t s)
+          : data     (static_cast<const char*> (d)),
+            size     (s),
+            position (0),
+            failed   (false)
+        {}
+
+        const char* readBytes (const size_t numBytes)
+        {
+            if (failed || numBytes > size - position) {
+                failed = true;
+                return nullptr;
+            }
+            const char* bytes = data + position;
+            position += numBytes;
+            return bytes;
+        }
+
+        juce::uint8 readByte ()
+        {
+            const char* bytes = readBytes (1);
+            return bytes != nullptr ? (juce::uint8) *bytes : 0;
+        }
+
+        juce::uint32 readInt ()
+        {
+            const char* bytes = readBytes (4);
+            return bytes != nullptr ? juce::ByteOrder::littleEndianInt (bytes) : 0;
+        }
+
+        juce::uint64 readInt64 ()
+        {
+            const char* bytes = readBytes (8);
+            return bytes != nullptr ? juce::ByteOrder::littleEndianInt64 (bytes) : 0;
+        }
+
+        double readDouble ()
+        {
+            const juce::uint64 bits = readInt64();
+            double value;
+            memcpy (&value, &bits, sizeof (value));
+            return value;
+        }
+
+        juce::var readValue ()
+        {
+            switch (readByte()) {
+                case BinaryVoid:   return juce::var();
+                case BinaryBool:   return readByte() != 0;
+                case BinaryInt:    return (int) readInt();
+                case BinaryInt64:  return (juce::int64) readInt64();
+                case BinaryDouble: return readDouble();
+                case BinaryString: {
+                    const juce::uint32 numBytes = readInt();
+                    const char* bytes = readBytes (numBytes);
+                    return bytes != nullptr ? juce::String::fromUTF8 (bytes, (int) numBytes) : juce::String();
+                }
+                default:
+                    failed = true;
+                    return juce::var();
+            }
+        }
+
+        bool hasFailed () const { return failed; }
+
+    private:
+        const char* data;
+        size_t      size;
+        size_t      position;
+        bool        failed;
+    };
+
+    inline bool getBit (const juce::Array<juce::uint64>& words, const int index) noexcept
+    {
+        return (words.getReference (index >> 6) >> (index & 63)) & 1;
+    }
+
+    inline void setBit (juce::Array<juce::uint64>& words, const int index, const bool value) noexcept
+    {
+        const juce::uint64 mask = ((juce::uint64) 1) << (index & 63);
+        juce::uint64& word = words.getReference (index >> 6);
+        word = value ? (word | mask) : (word & ~mask);
+    }
+
+    inline void appendBit (juce::Array<juce::uint64>& words, const int index, const bool value)
+    {
+        if ((index & 63) == 0)
+            words.add (0);
+
+        setBit (words, index, value);
+    }
+
+    /**
+     Evaluates a predicate for all values of a column, writing one bit per value. The inner
+     loop has no branches and a fixed length, so the compiler can vectorise it.
+     */
+    template <typename Type, typename Predicate>
+    void evaluateColumn (const Type* values, const int numValues, juce::uint64* words, Predicate predicate)
+    {
+        const int numFullWords = numValues / 64;
+        for (int w = 0; w < numFullWords; ++w) {
+            const Type* block = values + w * 64;
+            juce::uint64 bits = 0;
+            for (int i = 0; i < 64; ++i)
+                bits |= ((juce::uint64) predicate (block [i])) << i;
+            words [w] = bits;
+        }
+
+        const int remaining = numValues - numFullWords * 64;
+        if (remaining > 0) {
+            const Type* block = values + numFullWords * 64;
+            juce::uint64 bits = 0;
+            for (int i = 0; i < remaining; ++i)
+                bits |= ((juce::uint64) predicate (block [i])) << i;
+            words [numFullWords] = bits;
+        }
+    }
+
+#if FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS
+    /** A blocking connection to a unix domain socket, exchanging lines of text. Sending and reading
+        take a deadline (see juce::Time::getMillisecondCounter) for the whole exchange, so a service
+        answering in many small pieces can't stretch it beyond its timeout */
+    class UnixSocketConnection {
+    public:
+        /** A longer line fails the exchange, so a broken service can't exhaust the memory */
+        static const size_t maxLineLength = 1 << 20;
+
+        UnixSocketConnection (const juce::String& path, const juce::uint32 deadline)
+          : handle (-1),
+            buffer (4096),
+            start  (0),
+            end    (0)
+        {
+            sockaddr_un address;
+            memset (&address, 0, sizeof (address));
+            address.sun_family = AF_UNIX;
+            if (path.getNumBytesAsUTF8() >= sizeof (address.sun_path))
+                return;
+
+            path.copyToUTF8 (address.sun_path, sizeof (address.sun_path));
+
+            const int timeoutMs = getRemainingMilliseconds (deadline);
+            if (timeoutMs <= 0)
+                return;
+
+            handle = ::socket (AF_UNIX, SOCK_STREAM, 0);
+            if (handle < 0)
+                return;
+
+            // limits a blocking connect, the exchange itself waits with poll
+            timeval timeout;
+            timeout.tv_sec  = timeoutMs / 1000;
+            timeout.tv_usec = (timeoutMs % 1000) * 1000;
+            ::setsockopt (handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+            ::setsockopt (handle, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+           #ifdef SO_NOSIGPIPE
+            const int noSigPipe = 1;
+            ::setsockopt (handle, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof (noSigPipe));
+           #endif
+
+            if (::connect (handle, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0) {
+                ::close (handle);
+                handle = -1;
+            }
+        }
+
+        ~UnixSocketConnection ()
+        {
+            if (handle >= 0)
+                ::close (handle);
+        }
+
+        bool isConnected () const
+        {
+            return handle >= 0;
+        }
+
+        static int getRemainingMilliseconds (const juce::uint32 deadline)
+        {
+            return (int) (deadline - juce::Time::getMillisecondCounter());
+        }
+
+        bool send (const juce::String& text, const juce::uint32 deadline)
+        {
+           #ifdef MSG_NOSIGNAL
+            const int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+           #else
+            const int flags = MSG_DONTWAIT;
+           #endif
+            const char* data = text.toRawUTF8();
+            size_t remaining = text.getNumBytesAsUTF8();
+            while (remaining > 0) {
+                if (! waitFor (POLLOUT, getRemainingMilliseconds (deadline)))
+                    return false;
+
+                const ssize_t numSent = ::send (handle, data, remaining, flags);
+                if (numSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                    continue;
+                if (numSent <= 0)
+                    return false;
+                data      += numSent;
+                remaining -= (size_t) numSent;
+            }
+            return true;
+        }
+
+        /** Waits until a line or the end of the connection can be read */
+        bool waitForData (const int timeoutMs)
+        {
+            if (memchr (static_cast<const char*> (buffer.getData()) + start, '\n', end - start) != nullptr)
+                return true;
+
+            return waitFor (POLLIN, timeoutMs);
+        }
+
+        /** Reads the next line. Returns false on errors, if the deadline passed, if the line is
+            longer than maxLineLength or if the service closed the connection */
+        bool readLine (juce::String& line, const juce::uint32 deadline)
+        {
+            for (;;) {
+                const char* data = static_cast<const char*> (buffer.getData());
+                if (const void* found = memchr (data + start, '\n', end - start)) {
+                    const size_t lineEnd = (size_t) (static_cast<const char*> (found) - data);
+                    line  = juce::String::fromUTF8 (data + start, (int) (lineEnd - start)).trimEnd();
+                    start = lineEnd + 1;
+                    return true;
+                }
+
+                if (start > 0) {
+                    memmove (buffer.getData(), data + start, end - start);
+                    end  -= start;
+                    start = 0;
+                }
+                if (end > maxLineLength)
+                    return false;
+                if (buffer.getSize() - end < 1024)
+                    buffer.setSize (buffer.getSize() * 2);
+
+                if (! waitFor (POLLIN, getRemainingMilliseconds (deadline)))
+                    return false;
+
+                const ssize_t numRead = ::recv (handle, static_cast<char*> (buffer.getData()) + end,
+                                                buffer.getSize() - end, MSG_DONTWAIT);
+                if (numRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                    continue;
+                if (numRead <= 0)
+                    return false;
+
+                end += (size_t) numRead;
+            }
+        }
+
+    private:
+        bool waitFor (const short events, const int timeoutMs)
+        {
+            if (timeoutMs <= 0)
+                return false;
+
+            pollfd descriptor;
+            descriptor.fd      = handle;
+            descriptor.events  = events;
+            descriptor.revents = 0;
+            return ::poll (&descriptor, 1, timeoutMs) > 0;
+        }
+
+        int               handle;
+        juce::MemoryBlock buffer;
+        size_t            start;
+        size_t            end;
+    };
+
+    /** A connection accepted by KeyValueService */
+    struct ServiceClient {
+        ServiceClient (const int h) : handle (h), watching (false) {}
+        ~ServiceClient () { ::close (handle); }
+
+        /** Fails if the client doesn't read within the send timeout of a second, it is dropped then */
+        bool send (const juce::String& text)
+        {
+           #ifdef MSG_NOSIGNAL
+            const int flags = MSG_NOSIGNAL;
+           #else
+            const int flags = 0;
+           #endif
+            const char* data = text.toRawUTF8();
+            size_t remaining = text.getNumBytesAsUTF8();
+            while (remaining > 0) {
+                const ssize_t numSent = ::send (handle, data, remaining, flags);
+                if (numSent <= 0)
+                    return false;
+                data      += numSent;
+                remaining -= (size_t) numSent;
+            }
+            return true;
+        }
+
+        int          handle;
+        juce::String pending;   //< received text without a newline yet
+        bool         watching;
+    };
+#endif
+
+    /**
+     A help catalog starts with a magic and the number of entries, followed by a table of
+     entries sorted by the hash of their key and the UTF-8 strings:
+     uint64 keyHash, uint32 keyOffset, uint32 keyLength, uint32 textOffset, uint32 textLength
+     */
+    const char*  helpCatalogMagic     = "OPTHELP1";
+    const size_t helpCatalogEntrySize = 24;
+
+    struct HelpCatalogEntry {
+        juce::uint64 keyHash;
+        int          index;
+    };
+
+    bool findCatalogText (const void* data, const size_t size, const juce::String& key, juce::String& text)
+    {
+        BinaryReader header (data, size);
+        const char* magic = header.readBytes (8);
+        const juce::uint32 numEntries = header.readInt();
+        if (magic == nullptr || memcmp (magic, helpCatalogMagic, 8) != 0 || header.hasFailed()
+            || numEntries > (size - 12) / helpCatalogEntrySize)
+            return false;
+
+        const char*        table   = static_cast<const char*> (data) + 12;
+        const juce::uint64 keyHash = stableHash (key.toRawUTF8(), key.getNumBytesAsUTF8());
+
+        juce::uint32 start = 0;
+        juce::uint32 end   = numEntries;
+        while (start < end) {
+            const juce::uint32 middle = (start + end) / 2;
+            if (juce::ByteOrder::littleEndianInt64 (table + middle * helpCatalogEntrySize) < keyHash)
+                start = middle + 1;
+            else
+                end = middle;
+        }
+
+        // different keys might share a hash
+        for (juce::uint32 i = start; i < numEntries; ++i) {
+            BinaryReader entry (table + i * helpCatalogEntrySize, helpCatalogEntrySize);
+            if (entry.readInt64() != keyHash)
+                return false;
+
+            const juce::uint32 keyOffset  = entry.readInt();
+            const juce::uint32 keyLength  = entry.readInt();
+            const juce::uint32 textOffset = entry.readInt();
+            const juce::uint32 textLength = entry.readInt();
+            if ((juce::uint64) keyOffset + keyLength > size || (juce::uint64) textOffset + textLength > size)
+                return false;
+
+            const char* bytes = static_cast<const char*> (data);
+            if (keyLength == key.getNumBytesAsUTF8() && memcmp (bytes + keyOffset, key.toRawUTF8(), keyLength) == 0) {
+                text = juce::String::fromUTF8 (bytes + textOffset, (int) textLength);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Reads includes and converts sections for all parsers. Loading is mostly waiting for the
+        storage, so it has more threads than cores */
+    juce::ThreadPool& getConfigPool ()
+    {
+        static juce::ThreadPool pool (juce::jmax (4, juce::SystemStats::getNumCpus()));
+        return pool;
+    }
+
+    /** Includes nested deeper are reported as errors */
+    const int maxIncludeDepth = 16;
+
+    /** Calls function for each index from 0 to num - 1 on the threads of the pool and waits for all */
+    void forEachConcurrently (juce::ThreadPool& pool, const int num, const std::function<void (int)>& function)
+    {
+        const int           numWorkers = juce::jmin (num, pool.getNumThreads());
+        std::atomic<int>    next (0);
+        std::atomic<int>    running (numWorkers);
+        juce::WaitableEvent finished;
+
+        for (int worker = 0; worker < numWorkers; ++worker) {
+            pool.addJob ([&] {
+                for (int i = next++; i < num; i = next++)
+                    function (i);
+
+                if (--running == 0)
+                    finished.signal();
+            });
+        }
+
+        if (numWorkers > 0)
+            finished.wait();
+    }
+
+    /**
+     A histogram of latencies in nanoseconds with logarithmic buckets: below 8 each value has a
+     bucket, above each power of two is split into 8 buckets. Threads count into different shards
+     with relaxed atomics, so recording never waits for a lock.
+     */
+    class LatencyHistogram {
+    public:
+        LatencyHistogram ()
+        {
+            reset();
+        }
+
+        void record (const juce::uint64 nanoseconds) noexcept
+        {
+            Shard& shard = shards [getThreadShard()];
+            shard.buckets [getBucket (nanoseconds)].fetch_add (1, std::memory_order_relaxed);
+            shard.count.fetch_add (1, std::memory_order_relaxed);
+            shard.sum.fetch_add (nanoseconds, std::memory_order_relaxed);
+
+            juce::uint64 minimum = shard.minimum.load (std::memory_order_relaxed);
+            while (nanoseconds < minimum && ! shard.minimum.compare_exchange_weak (minimum, nanoseconds, std::memory_order_relaxed)) {}
+
+            juce::uint64 maximum = shard.maximum.load (std::memory_order_relaxed);
+            while (nanoseconds > maximum && ! shard.maximum.compare_exchange_weak (maximum, nanoseconds, std::memory_order_relaxed)) {}
+        }
+
+        OptionsParser::LatencyStats getStats () const
+        {
+            juce::HeapBlock<juce::uint64> buckets (numBuckets, true);
+            juce::uint64 count   = 0;
+            juce::uint64 sum     = 0;
+            juce::uint64 minimum = std::numeric_limits<juce::uint64>::max();
+            juce::uint64 maximum = 0;
+
+            for (const Shard& shard : shards) {
+                for (int i = 0; i < numBuckets; ++i)
+                    buckets [i] += shard.buckets [i].load (std::memory_order_relaxed);
+
+                count  += shard.count.load (std::memory_order_relaxed);
+                sum    += shard.sum.load (std::memory_order_relaxed);
+                minimum = juce::jmin (minimum, shard.minimum.load (std::memory_order_relaxed));
+                maximum = juce::jmax (maximum, shard.maximum.load (std::memory_order_relaxed));
+            }
+
+            OptionsParser::LatencyStats stats;
+            if (count == 0)
+                return stats;
+
+            stats.count   = (juce::int64) count;
+            stats.mean    = sum / (double) count / 1000.0;
+            stats.minimum = minimum / 1000.0;
+            stats.maximum = maximum / 1000.0;
+            stats.p50     = getPercentile (buckets, count, 0.5)   / 1000.0;
+            stats.p99     = getPercentile (buckets, count, 0.99)  / 1000.0;
+            stats.p999    = getPercentile (buckets, count, 0.999) / 1000.0;
+            return stats;
+        }
+
+        void reset () noexcept
+        {
+            for (Shard& shard : shards) {
+                for (std::atomic<juce::uint64>& bucket : shard.buckets)
+                    bucket.store (0, std::memory_order_relaxed);
+
+                shard.count.store (0, std::memory_order_relaxed);
+                shard.sum.store (0, std::memory_order_relaxed);
+                shard.minimum.store (std::numeric_limits<juce::uint64>::max(), std::memory_order_relaxed);
+                shard.maximum.store (0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        enum {
+            numShards     = 16,
+            subBucketBits = 3,
+            maxExponent   = 42,    // about 73 minutes, longer latencies go to the last bucket
+            numBuckets    = (maxExponent - subBucketBits + 2) << subBucketBits
+        };
+
+        static int getBucket (const juce::uint64 value) noexcept
+        {
+            if (value < (1 << subBucketBits))
+                return (int) value;
+
+            int exponent = subBucketBits;
+            while (exponent < maxExponent && (value >> (exponent + 1)) != 0)
+                ++exponent;
+
+            const int subBucket = (int) ((value >> (exponent - subBucketBits)) & ((1 << subBucketBits) - 1));
+            return juce::jmin (numBuckets - 1, ((exponent - subBucketBits + 1) << subBucketBits) + subBucket);
+        }
+
+        /** Returns the middle of the values in a bucket */
+        static double getBucketValue (const int bucket) noexcept
+        {
+            if (bucket < (1 << subBucketBits))
+                return bucket;
+
+            const int    exponent  = (bucket >> subBucketBits) + subBucketBits - 1;
+            const int    subBucket = bucket & ((1 << subBucketBits) - 1);
+            const double width     = std::ldexp (1.0, exponent - subBucketBits);
+            return ((1 << subBucketBits) + subBucket) * width + width / 2;
+        }
+
+        static double getPercentile (const juce::uint64* buckets, const juce::uint64 count, const double percentile) noexcept
+        {
+            const juce::uint64 rank = juce::jmax ((juce::uint64) 1, (juce::uint64) std::ceil (percentile * count));
+            juce::uint64 seen = 0;
+            for (int i = 0; i < numBuckets; ++i) {
+                seen += buckets [i];
+                if (seen >= rank)
+                    return getBucketValue (i);
+            }
+            return getBucketValue (numBuckets - 1);
+        }
+
+        static int getThreadShard () noexcept
+        {
+            static std::atomic<int> numThreads (0);
+            static thread_local int shard = numThreads++ % numShards;
+            return shard;
+        }
+
+        // each shard on its own cache lines, so threads don't invalidate each other's counters
+        struct alignas (64) Shard {
+            std::atomic<juce::uint64> buckets [numBuckets];
+            std::atomic<juce::uint64> count;
+            std::atomic<juce::uint64> sum;
+            std::atomic<juce::uint64> minimum;
+            std::atomic<juce::uint64> maximum;
+        };
+
+        Shard shards [numShards];
+    };
+
+    std::atomic<bool> latencyStatsEnabled (false);
+
+    LatencyHistogram& getLatencyHistogram (const OptionsParser::Operation operation)
+    {
+        static LatencyHistogram histograms [OptionsParser::numOperations];
+        return histograms [operation];
+    }
+
+    /** Number of ScopedLatency and ScopedLatencyPause alive on this thread */
+    thread_local int latencyDepth = 0;
+
+    /** Measures the time until it goes out of scope. Nested measurements on the same thread,
+        like getHelpText rendering the group sections, are counted once */
+    class ScopedLatency {
+    public:
+        ScopedLatency (const OptionsParser::Operation op) noexcept
+          : operation (op),
+            start     (0),
+            outermost (latencyStatsEnabled.load (std::memory_order_relaxed) && latencyDepth == 0)
+        {
+            if (outermost)
+                start = juce::Time::getHighResolutionTicks();
+            ++latencyDepth;
+        }
+
+        ~ScopedLatency ()
+        {
+            --latencyDepth;
+            if (outermost) {
+                const double seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+                getLatencyHistogram (operation).record ((juce::uint64) (seconds * 1.0e9));
+            }
+        }
+
+    private:
+        OptionsParser::Operation  operation;
+        juce::int64               start;
+        bool                      outermost;
+    };
+
+    /** Keeps the operations on this thread out of the latency statistics, e.g. while replaying a trace */
+    class ScopedLatencyPause {
+    public:
+        ScopedLatencyPause () noexcept  { ++latencyDepth; }
+        ~ScopedLatencyPause ()          { --latencyDepth; }
+    };
+
+    /** The validators of all parsers run on this pool. It is not owned by a parser, so a job overrunning
+        its time budget neither blocks the destruction of its parser nor is killed by it */
+    juce::ThreadPool& getValidatorPool ()
+    {
+        static juce::ThreadPool pool (juce::jmax (4, juce::SystemStats::getNumCpus()));
+        return pool;
+    }
+
+    /** Shared with the validator jobs, so a job finishing after the time budget doesn't touch the parser */
+    struct ValidationState {
+        ValidationState (const int numJobs)
+          : remaining (numJobs)
+        {
+            finished.insertMultiple (0, false, numJobs);
+            for (int i = 0; i < numJobs; ++i)
+                errors.add (juce::String());
+        }
+
+        juce::SpinLock      lock;
+        juce::Array<bool>   finished;
+        juce::StringArray   errors;
+        std::atomic<int>    remaining;
+        juce::WaitableEvent done;
+    };
+
+    /** Splits "name = value", returns false if there is no "=" */
+    bool splitAssignment (const juce::String& line, juce::String& name, juce::String& value)
+    {
+        const int equals = line.indexOfChar ('=');
+        if (equals < 0)
+            return false;
+
+        name  = line.substring (0, equals).trim();
+        value = line.substring (equals + 1).trim();
+        if (value.isQuotedString())
+            value = value.unquoted();
+
+        return true;
+    }
+
+    /**
+     A config snapshot starts with a header of 32 bytes:
+     magic, uint32 version (2), uint32 number of slots, uint64 schema fingerprint, uint64 reserved
+     followed by one entry of 32 bytes per slot and the zero terminated UTF-8 strings:
+     int64 intValue, double doubleValue, uint32 stringOffset, uint32 stringLength,
+     uint32 isSet (1 if the value came from a config or the arguments), uint32 reserved.
+     All numbers are little endian, stringOffset counts from the start of the file
+     */
+    const char*  configSnapshotMagic     = "OPTSNAP1";
+    const int    configSnapshotVersion   = 2;
+    const size_t configSnapshotHeaderSize = 32;
+    const size_t configSnapshotEntrySize  = 32;
+
+    const char*  traceMagic   = "OPTTRACE";
+    const int    traceVersion = 2;
+
+    const char*  configCacheMagic   = "OPTCACHE";
+    const int    configCacheVersion = 1;
+
+    /** Interprets the text of a flag or boolean config value */
+    bool isTrueText (const juce::String& text)
+    {
+        const juce::String trimmed = text.trim();
+        return ! (trimmed.isEmpty() || trimmed == "0" || trimmed.equalsIgnoreCase ("false")
+                  || trimmed.equalsIgnoreCase ("no") || trimmed.equalsIgnoreCase ("off"));
+    }
+
+    bool toBoolean (const juce::var& value)
+    {
+        return value.isString() ? isTrueText (value.toString()) : (bool) value;
+    }
+
+    /** Checks the text is a number, an optional sign followed by digits. Unless it is an integer,
+        a fraction and an exponent may follow. Whitespace around it is ignored */
+    bool isNumberText (const juce::String& text, const bool integer)
+    {
+        const juce::String trimmed = text.trim();
+        int i = 0;
+        if (trimmed [i] == '+' || trimmed [i] == '-')
+            ++i;
+
+        int numDigits = 0;
+        while (juce::CharacterFunctions::isDigit (trimmed [i])) { ++i; ++numDigits; }
+
+        if (! integer && trimmed [i] == '.') {
+            ++i;
+            while (juce::CharacterFunctions::isDigit (trimmed [i])) { ++i; ++numDigits; }
+        }
+
+        if (numDigits == 0)
+            return false;
+
+        if (! integer && (trimmed [i] == 'e' || trimmed [i] == 'E')) {
+            ++i;
+            if (trimmed [i] == '+' || trimmed [i] == '-')
+                ++i;
+            if (! juce::CharacterFunctions::isDigit (trimmed [i]))
+                return false;
+            while (juce::CharacterFunctions::isDigit (trimmed [i]))
+                ++i;
+        }
+
+        return i == trimmed.length();
+    }
+
+    /** Splits a text into lower case words for the help index */
+    juce::StringArray splitWords (const juce::String& text)
+    {
+        juce::StringArray words;
+        words.addTokens (text.toLowerCase(), " \t\r\n-_.,;:!?()[]{}<>/\\|=+*'\"", "");
+        words.removeEmptyStrings();
+        return words;
+    }
+
+    bool isGzipStream (juce::InputStream& stream)
+    {
+        const juce::int64 start = stream.getPosition();
+        juce::uint8 magic [2] = { 0, 0 };
+        const int numRead = stream.read (magic, 2);
+        stream.setPosition (start);
+        return numRead == 2 && magic [0] == 0x1f && magic [1] == 0x8b;
+    }
+}
+
+OptionsParser::OptionsParser ()
+  : indexIsDirty       (false),
+    helpIndexIsDirty   (true),
+    slowParseThreshold (0.0),
+    maxSlowParses      (0),
+    nextSlowParse      (0)
+{
+    errorToken [0] = 0;
+}
+
 OptionsParser::Option* OptionsParser::addOption (juce::String optId, juce::String optArg,
                                                    const OptionType type, const bool req)
 {
-    OptionsParser::Option* o = new OptionsParser::Option (optId);
-    o->arg      = optArg;
-    o->type     = type;
-    return options.add (o);
+    OptionsParser::Option* o = new OptionsParser::Option (optId);
+    o->arg      = optArg;
+    o->type     = type;
+    o->groupId  = currentGroupId;
+    idIndex.add (optId, options.size());
+    indexIsDirty     = true;
+    helpIndexIsDirty = true;
+    invalidateHelpSections();
+    return options.add (o);
+}
+
+int OptionsParser::findSlot (const juce::String& argument, const bool endOfArguments, const ValueSink& sink) const
+{
+    const char*  utf8     = argument.toRawUTF8();
+    const size_t numBytes = argument.getNumBytesAsUTF8();
+
+    if (!endOfArguments && argument.startsWith("--")) {
+        return longArgIndex.find (utf8 + 2, numBytes - 2);
+    }
+    else if (!endOfArguments && argument.startsWith("-")) {
+        return argIndex.find (utf8 + 1, numBytes - 1);
+    }
+    else {
+        // options without arg and optArg take the argument directly
+        for (int slot : positionalSlots)
+            if (! sink.isSet (slot))
+                return slot;
+    }
+
+    return -1;
+}
+
+struct OptionsParser::OptionSink : public OptionsParser::ValueSink
+{
+    OptionSink (juce::OwnedArray<Option>& o) : options (o) {}
+
+    bool isSet (const int slot) const override
+    {
+        return options.getUnchecked (slot)->isOptionSet();
+    }
+
+    void setValue (const int slot, const juce::String& value) override
+    {
+        options.getUnchecked (slot)->setValue (value);
+    }
+
+    void setFlag (const int slot) override
+    {
+        options.getUnchecked (slot)->setValue (true);
+    }
+
+    juce::OwnedArray<Option>& options;
+};
+
+/** First pass of parseArgumentsCompact, counts values and bytes */
+struct OptionsParser::CountingSink : public OptionsParser::ValueSink
+{
+    CountingSink (juce::Array<bool>& flags)
+      : setFlags  (flags),
+        numValues (0),
+        numBytes  (0)
+    {}
+
+    bool isSet (const int slot) const override
+    {
+        return setFlags.getReference (slot);
+    }
+
+    void setValue (const int slot, const juce::String& value) override
+    {
+        setFlags.getReference (slot) = true;
+        ++numValues;
+        numBytes += value.getNumBytesAsUTF8() + 1;
+    }
+
+    void setFlag (const int slot) override
+    {
+        setFlags.getReference (slot) = true;
+        ++numValues;
+        numBytes += 2;
+    }
+
+    juce::Array<bool>& setFlags;
+    int                numValues;
+    size_t             numBytes;
+};
+
+/** Second pass of parseArgumentsCompact, copies the values into the preallocated block */
+struct OptionsParser::FillingSink : public OptionsParser::ValueSink
+{
+    FillingSink (juce::Array<bool>& flags, CompactResult::Entry* e, char* s)
+      : setFlags  (flags),
+        entries   (e),
+        strings   (s),
+        numValues (0),
+        offset    (0)
+    {}
+
+    bool isSet (const int slot) const override
+    {
+        return setFlags.getReference (slot);
+    }
+
+    void setValue (const int slot, const juce::String& value) override
+    {
+        const size_t numBytes = value.getNumBytesAsUTF8();
+        memcpy (strings + offset, value.toRawUTF8(), numBytes);
+        strings [offset + numBytes] = 0;
+        add (slot, numBytes + 1);
+    }
+
+    void setFlag (const int slot) override
+    {
+        strings [offset]     = '1';
+        strings [offset + 1] = 0;
+        add (slot, 2);
+    }
+
+    void add (const int slot, const size_t numBytes)
+    {
+        setFlags.getReference (slot) = true;
+        entries [numValues].slot   = slot;
+        entries [numValues].offset = offset;
+        ++numValues;
+        offset += numBytes;
+    }
+
+    juce::Array<bool>&    setFlags;
+    CompactResult::Entry* entries;
+    char*                 strings;
+    int                   numValues;
+    size_t                offset;
+};
+
+void OptionsParser::updateIndex ()
+{
+    if (! indexIsDirty)
+        return;
+
+    argIndex.clear();
+    longArgIndex.clear();
+    positionalSlots.clearQuick();
+
+    for (int slot = 0; slot < options.size(); ++slot) {
+        const Option* o = options.getUnchecked (slot);
+        if (o->arg.isNotEmpty())     argIndex.add (o->arg, slot);
+        if (o->longArg.isNotEmpty()) longArgIndex.add (o->longArg, slot);
+        if (o->arg.isEmpty() && o->longArg.isEmpty())
+            positionalSlots.add (slot);
+    }
+    indexIsDirty = false;
+}
+
+void OptionsParser::invalidateIndex ()
+{
+    idIndex.clear();
+    for (int slot = 0; slot < options.size(); ++slot)
+        idIndex.add (options.getUnchecked (slot)->optionId, slot);
+
+    indexIsDirty     = true;
+    helpIndexIsDirty = true;
+    invalidateHelpSections();
+}
+
+void OptionsParser::setLimits (const Limits& newLimits)
+{
+    limits = newLimits;
+}
+
+const OptionsParser::Limits& OptionsParser::getLimits () const
+{
+    return limits;
+}
+
+OptionsParser::ParseError OptionsParser::checkLimits (const juce::StringArray& arguments, int& position) const noexcept
+{
+    position = -1;
+    if (limits.maxTokens > 0 && arguments.size() > limits.maxTokens)
+        return TooManyArguments;
+
+    if (limits.maxTokenLength <= 0 && limits.maxTotalBytes <= 0)
+        return NoError;
+
+    juce::int64 totalBytes = 0;
+    for (int pos = 0; pos < arguments.size(); ++pos) {
+        const size_t numBytes = arguments [pos].getNumBytesAsUTF8();
+        if (limits.maxTokenLength > 0 && numBytes > (size_t) limits.maxTokenLength) {
+            position = pos;
+            return ArgumentTooLong;
+        }
+        totalBytes += (juce::int64) numBytes;
+        if (limits.maxTotalBytes > 0 && totalBytes > limits.maxTotalBytes) {
+            position = pos;
+            return ArgumentsTooLong;
+        }
+    }
+    return NoError;
+}
+
+juce::String OptionsParser::getHelpText () const
+{
+    const ScopedLatency latency (OperationHelp);
+    juce::String text (header);
+
+    const juce::String ungrouped = getGroupHelpText (juce::String());
+    if (ungrouped.isNotEmpty()) {
+        if (text.isNotEmpty()) text += NewLine();
+        text += ungrouped;
+    }
+    for (const Group& group : groups) {
+        const juce::String section = getGroupHelpText (group.groupId);
+        if (section.isNotEmpty()) {
+            if (text.isNotEmpty()) text += NewLine();
+            text += section;
+        }
+    }
+    if (footer.isNotEmpty()) {
+        if (text.isNotEmpty()) text += NewLine();
+        text += footer;
+    }
+    return text;
+}
+
+void OptionsParser::setHelpCatalog (const juce::File& catalogFile)
+{
+    helpCatalogFile = catalogFile;
+    helpCatalog.reset();
+    helpIndexIsDirty = true;
+    invalidateHelpSections();
+}
+
+bool OptionsParser::writeHelpCatalog (juce::OutputStream& stream, const juce::StringPairArray& helpTexts)
+{
+    const juce::StringArray& keys  = helpTexts.getAllKeys();
+    const juce::StringArray& texts = helpTexts.getAllValues();
+
+    juce::Array<HelpCatalogEntry> entries;
+    for (int i = 0; i < keys.size(); ++i) {
+        HelpCatalogEntry entry;
+        entry.keyHash = stableHash (keys [i].toRawUTF8(), keys [i].getNumBytesAsUTF8());
+        entry.index   = i;
+        entries.add (entry);
+    }
+    std::sort (entries.begin(), entries.end(), [] (const HelpCatalogEntry& a, const HelpCatalogEntry& b) { return a.keyHash < b.keyHash; });
+
+    bool ok = stream.write (helpCatalogMagic, 8) && stream.writeInt (entries.size());
+
+    juce::uint64 offset = 12 + helpCatalogEntrySize * (size_t) entries.size();
+    for (const HelpCatalogEntry& entry : entries) {
+        const juce::uint64 keyLength  = keys  [entry.index].getNumBytesAsUTF8();
+        const juce::uint64 textLength = texts [entry.index].getNumBytesAsUTF8();
+        if (offset + keyLength + textLength > 0xffffffffULL)
+            return false;
+
+        ok = ok && stream.writeInt64 ((juce::int64) entry.keyHash)
+                && stream.writeInt ((int) offset)
+                && stream.writeInt ((int) keyLength)
+                && stream.writeInt ((int) (offset + keyLength))
+                && stream.writeInt ((int) textLength);
+        offset += keyLength + textLength;
+    }
+
+    for (const HelpCatalogEntry& entry : entries) {
+        const juce::String& key  = keys  [entry.index];
+        const juce::String& text = texts [entry.index];
+        ok = ok && stream.write (key.toRawUTF8(), key.getNumBytesAsUTF8())
+                && stream.write (text.toRawUTF8(), text.getNumBytesAsUTF8());
+    }
+    return ok;
+}
+
+juce::String OptionsParser::getCatalogHelpText (const Option& option) const
+{
+    if (helpCatalogFile == juce::File())
+        return option.helpText;
+
+    const juce::ScopedLock lock (helpLock);
+
+    if (helpCatalog == nullptr)
+        helpCatalog.reset (new juce::MemoryMappedFile (helpCatalogFile, juce::MemoryMappedFile::readOnly));
+
+    juce::String text;
+    if (helpCatalog->getData() != nullptr
+        && findCatalogText (helpCatalog->getData(), helpCatalog->getSize(), option.optionId, text))
+        return text;
+
+    return option.helpText;
+}
+
+void OptionsParser::addGroup (const juce::String& groupId, const juce::String& title)
+{
+    // the options without group are shown without a title
+    jassert (groupId.isNotEmpty() || title.isEmpty());
+    if (groupId.isEmpty()) {
+        currentGroupId = juce::String();
+        return;
+    }
+
+    Group group;
+    group.groupId = groupId;
+    group.title   = title;
+    groups.add (group);
+    currentGroupId = groupId;
+    invalidateHelpSections();
+}
+
+juce::StringArray OptionsParser::getGroupIds () const
+{
+    juce::StringArray groupIds;
+    for (const Group& group : groups)
+        groupIds.add (group.groupId);
+    return groupIds;
+}
+
+juce::String OptionsParser::getGroupHelpText (juce::StringRef groupId) const
+{
+    const ScopedLatency latency (OperationHelp);
+    // section 0 holds the options without group
+    int section = 0;
+    if (groupId.isNotEmpty()) {
+        for (int i = 0; i < groups.size() && section == 0; ++i)
+            if (groups.getReference (i).groupId == groupId)
+                section = i + 1;
+
+        if (section == 0)
+            return String();
+    }
+
+    const juce::ScopedLock lock (helpLock);
+
+    if (helpSections.size() != groups.size() + 1) {
+        helpSections.clear();
+        for (int i = 0; i <= groups.size(); ++i)
+            helpSections.add (String());
+        helpSectionIsValid.clearQuick();
+        helpSectionIsValid.insertMultiple (0, false, groups.size() + 1);
+    }
+
+    // the values are public and might have been assigned directly, they show as defaults
+    if (helpValues.size() != options.size()) {
+        helpValues.resize (options.size());
+        helpIsSet.clearQuick();
+        helpIsSet.insertMultiple (0, false, options.size());
+        helpSectionIsValid.fill (false);
+    }
+
+    // a value set to the same as its default still hides the default
+    bool isValid = helpSectionIsValid.getReference (section);
+    for (int slot = 0; slot < options.size() && isValid; ++slot) {
+        const Option* o = options.getUnchecked (slot);
+        if (o->groupId == groupId && (! o->value.equalsWithSameType (helpValues.getReference (slot))
+                                      || o->isOptionSet() != helpIsSet.getReference (slot)))
+            isValid = false;
+    }
+
+    if (! isValid) {
+        juce::String text (section > 0 ? groups.getReference (section - 1).title : String());
+        for (int slot = 0; slot < options.size(); ++slot) {
+            const Option* o = options.getUnchecked (slot);
+            if (o->groupId == groupId) {
+                if (text.isNotEmpty()) text += NewLine();
+                text += o->getHelpText (getCatalogHelpText (*o));
+                helpValues.set (slot, o->value);
+                helpIsSet.set (slot, o->isOptionSet());
+            }
+        }
+        helpSections.set (section, text);
+        helpSectionIsValid.getReference (section) = true;
+    }
+
+    return helpSections [section];
+}
+
+void OptionsParser::invalidateHelpSections () noexcept
+{
+    helpSectionIsValid.fill (false);
+}
+
+void OptionsParser::buildHelpIndex () const
+{
+    helpIndex.clearQuick();
+
+    OptionIndex tokenIndex;
+    for (int slot = 0; slot < options.size(); ++slot) {
+        const Option* o = options.getUnchecked (slot);
+        const juce::StringArray words = splitWords (o->optionId + " " + o->arg + " " + o->longArg + " " + getCatalogHelpText (*o));
+        for (const juce::String& word : words) {
+            int index = tokenIndex.find (word);
+            if (index < 0) {
+                index = helpIndex.size();
+                HelpToken helpToken;
+                helpToken.token = word;
+                helpIndex.add (helpToken);
+                tokenIndex.add (word, index);
+            }
+
+            juce::Array<int>& slots = helpIndex.getReference (index).slots;
+            if (slots.isEmpty() || slots.getLast() != slot)
+                slots.add (slot);
+        }
+    }
+
+    std::sort (helpIndex.begin(), helpIndex.end(),
+               [] (const HelpToken& a, const HelpToken& b) { return a.token.compare (b.token) < 0; });
+
+    helpIndexIsDirty = false;
+}
+
+juce::String OptionsParser::searchHelpText (juce::StringRef pattern) const
+{
+    const ScopedLatency latency (OperationHelp);
+    const juce::StringArray words = splitWords (pattern);
+    if (words.isEmpty())
+        return getHelpText();
+
+    const juce::ScopedLock lock (helpLock);
+    if (helpIndexIsDirty)
+        buildHelpIndex();
+
+    // count for each option how many words of the pattern it matches
+    juce::Array<int> numMatches;
+    numMatches.insertMultiple (0, 0, options.size());
+
+    for (const juce::String& word : words) {
+        juce::Array<bool> matched;
+        matched.insertMultiple (0, false, options.size());
+
+        // all tokens starting with the word are next to each other in the sorted index
+        const HelpToken* token = std::lower_bound (helpIndex.begin(), helpIndex.end(), word,
+                                                   [] (const HelpToken& t, const juce::String& w) { return t.token.compare (w) < 0; });
+        for (; token != helpIndex.end() && token->token.startsWith (word); ++token)
+            for (int slot : token->slots)
+                matched.getReference (slot) = true;
+
+        for (int slot = 0; slot < options.size(); ++slot)
+            if (matched.getReference (slot))
+                ++numMatches.getReference (slot);
+    }
+
+    juce::String text;
+    for (int slot = 0; slot < options.size(); ++slot) {
+        if (numMatches.getReference (slot) == words.size()) {
+            if (text.isNotEmpty()) text += NewLine();
+            const Option* o = options.getUnchecked (slot);
+            text += o->getHelpText (getCatalogHelpText (*o));
+        }
+    }
+    return text;
+}
+
+bool OptionsParser::parseArguments (const juce::StringArray& arguments, const bool failOnUnknownOption)
+{
+    const ScopedLatency latency (OperationParse);
+    return parseIntoOptions (arguments, failOnUnknownOption, true).wasOk();
+}
+
+OptionsParser::ParseResult OptionsParser::tryParseArguments (const juce::StringArray& arguments,
+                                                             const bool failOnUnknownOption)
+{
+    const ScopedLatency latency (OperationParse);
+    return parseIntoOptions (arguments, failOnUnknownOption, false);
+}
+
+OptionsParser::ParseResult OptionsParser::parseIntoOptions (const juce::StringArray& arguments,
+                                                            const bool failOnUnknownOption,
+                                                            const bool buildMessages)
+{
+    errorMessage.clear();
+    invalidateHelpSections();
+
+    if (traceStream != nullptr) {
+        // the redaction needs the index
+        updateIndex();
+        writeTraceRecord (redactArguments (arguments), failOnUnknownOption);
+    }
+
+    // the phases are only timed, if slow parses are recorded
+    const bool   timed = slowParseThreshold > 0.0;
+    juce::int64  ticks [numParsePhases + 1];
+    ticks [PhaseIndex] = timed ? juce::Time::getHighResolutionTicks() : 0;
+
+    updateIndex();
+    ticks [PhaseArguments] = timed ? juce::Time::getHighResolutionTicks() : 0;
+
+    OptionSink sink (options);
+    ParseResult result = parse (arguments, failOnUnknownOption, buildMessages, sink);
+    ticks [PhaseArrays] = timed ? juce::Time::getHighResolutionTicks() : 0;
+
+    mapBinaryArrays (result, buildMessages);
+    ticks [PhaseValidation] = timed ? juce::Time::getHighResolutionTicks() : 0;
+
+    runValidators (result, buildMessages);
+
+    if (timed) {
+        ticks [numParsePhases] = juce::Time::getHighResolutionTicks();
+        const double milliseconds = juce::Time::highResolutionTicksToSeconds (ticks [numParsePhases] - ticks [PhaseIndex]) * 1000.0;
+        if (milliseconds >= slowParseThreshold) {
+            double phaseMilliseconds [numParsePhases];
+            for (int phase = 0; phase < numParsePhases; ++phase)
+                phaseMilliseconds [phase] = juce::Time::highResolutionTicksToSeconds (ticks [phase + 1] - ticks [phase]) * 1000.0;
+            recordSlowParse (arguments, milliseconds, phaseMilliseconds);
+        }
+    }
+    return result;
+}
+
+void OptionsParser::setSlowParseLogging (const double thresholdMilliseconds, const int maxRecords,
+                                         std::function<void (const SlowParse&)> onSlowParse)
+{
+    slowParseThreshold = thresholdMilliseconds;
+    maxSlowParses      = juce::jmax (0, maxRecords);
+    nextSlowParse      = 0;
+    slowParseCallback  = onSlowParse;
+    slowParses.clear();
+}
+
+juce::Array<OptionsParser::SlowParse> OptionsParser::getSlowParses () const
+{
+    // the buffer is full once it wrapped around, then the oldest is at nextSlowParse
+    juce::Array<SlowParse> ordered;
+    for (int i = 0; i < slowParses.size(); ++i)
+        ordered.add (slowParses.getReference ((nextSlowParse + i) % slowParses.size()));
+    return ordered;
+}
+
+juce::StringArray OptionsParser::redactArguments (const juce::StringArray& arguments) const
+{
+    juce::StringArray redacted (arguments);
+    bool endOfArguments = false;
+    int  numPositionals = 0;
+
+    // follows parse, but a sensitive option always takes the next argument as its value, even if
+    // it is repeated or the parse stopped early
+    for (int pos = 0; pos < arguments.size(); ++pos) {
+        const juce::String& argument = arguments [pos];
+        if (argument == "--") {
+            endOfArguments = true;
+            continue;
+        }
+
+        const int equals = (! endOfArguments && argument.startsWith ("--")) ? argument.indexOfChar ('=') : -1;
+        if (equals > 2) {
+            const int slot = longArgIndex.find (argument.substring (2, equals));
+            if (slot >= 0 && options.getUnchecked (slot)->sensitive)
+                redacted.set (pos, argument.substring (0, equals + 1) + "***");
+            continue;
+        }
+
+        int slot = -1;
+        if (! endOfArguments && argument.startsWith ("--"))
+            slot = longArgIndex.find (argument.substring (2));
+        else if (! endOfArguments && argument.startsWith ("-"))
+            slot = argIndex.find (argument.substring (1));
+        else if (numPositionals < positionalSlots.size())
+            slot = positionalSlots [numPositionals++];
+
+        if (slot < 0 || ! options.getUnchecked (slot)->sensitive)
+            continue;
+
+        const Option* option = options.getUnchecked (slot);
+        if (option->arg.isEmpty() && option->longArg.isEmpty())
+            redacted.set (pos, "***");
+        else if (option->type != OptBoolean && pos + 1 < arguments.size())
+            redacted.set (++pos, "***");
+    }
+    return redacted;
+}
+
+void OptionsParser::recordSlowParse (const juce::StringArray& arguments, const double milliseconds,
+                                     const double* phaseMilliseconds)
+{
+    SlowParse slowParse;
+    slowParse.time              = juce::Time::getCurrentTime();
+    slowParse.arguments         = redactArguments (arguments);
+    slowParse.schemaFingerprint = getSchemaFingerprint();
+    slowParse.milliseconds      = milliseconds;
+    for (int phase = 0; phase < numParsePhases; ++phase)
+        slowParse.phaseMilliseconds [phase] = phaseMilliseconds [phase];
+
+    if (slowParseCallback)
+        slowParseCallback (slowParse);
+
+    if (maxSlowParses == 0)
+        return;
+
+    if (slowParses.size() < maxSlowParses) {
+        slowParses.add (slowParse);
+    }
+    else {
+        slowParses.set (nextSlowParse, slowParse);
+        nextSlowParse = (nextSlowParse + 1) % maxSlowParses;
+    }
+}
+
+bool OptionsParser::startTraceCapture (const juce::File& traceFile, const juce::StringArray& environmentVariables)
+{
+    stopTraceCapture();
+
+    // records are only appended to a trace of this version
+    if (traceFile.getSize() > 0) {
+        juce::FileInputStream existing (traceFile);
+        char magic [8];
+        if (existing.failedToOpen() || existing.read (magic, 8) != 8 || memcmp (magic, traceMagic, 8) != 0
+              || existing.readInt() != traceVersion)
+            return false;
+    }
+
+    std::unique_ptr<juce::FileOutputStream> stream (new juce::FileOutputStream (traceFile));
+    if (stream->failedToOpen())
+        return false;
+
+    if (stream->getPosition() == 0) {
+        stream->write (traceMagic, 8);
+        stream->writeInt (traceVersion);
+    }
+
+    traceStream.swap (stream);
+    traceEnvironment = environmentVariables;
+    return true;
+}
+
+void OptionsParser::stopTraceCapture ()
+{
+    if (traceStream != nullptr)
+        traceStream->flush();
+
+    traceStream.reset();
+    traceConfigSources.clear();
+    traceConfigHashes.clear();
+}
+
+void OptionsParser::writeTraceRecord (const juce::StringArray& arguments, const bool failOnUnknownOption)
+{
+    juce::FileOutputStream& stream = *traceStream;
+
+    stream.writeBool (failOnUnknownOption);
+    stream.writeInt (arguments.size());
+    for (const juce::String& argument : arguments)
+        stream.writeString (argument);
+
+    stream.writeInt (traceEnvironment.size());
+    for (const juce::String& name : traceEnvironment) {
+        stream.writeString (name);
+        stream.writeString (juce::SystemStats::getEnvironmentVariable (name, juce::String()));
+    }
+
+    stream.writeInt (traceConfigSources.size());
+    for (int i = 0; i < traceConfigSources.size(); ++i) {
+        stream.writeString (traceConfigSources [i]);
+        stream.writeInt64 ((juce::int64) traceConfigHashes [i]);
+    }
+
+    // the configs belong to the next parse only
+    traceConfigSources.clearQuick();
+    traceConfigHashes.clearQuick();
+
+    // a crashing tool still leaves a complete trace
+    stream.flush();
+}
+
+bool OptionsParser::readTrace (const juce::File& traceFile, juce::Array<TraceRecord>& records)
+{
+    juce::FileInputStream fileStream (traceFile);
+    if (fileStream.failedToOpen())
+        return false;
+
+    juce::BufferedInputStream stream (fileStream, 1 << 16);
+    char magic [8];
+    if (stream.read (magic, 8) != 8 || memcmp (magic, traceMagic, 8) != 0 || stream.readInt() != traceVersion)
+        return false;
+
+    // every count needs at least one byte per item, which protects from huge allocations
+    auto readCount = [&stream] (int& count) {
+        if (stream.getNumBytesRemaining() < 4)
+            return false;
+        count = stream.readInt();
+        return count >= 0 && count <= stream.getNumBytesRemaining();
+    };
+
+    while (! stream.isExhausted()) {
+        TraceRecord record;
+        int count;
+
+        record.failOnUnknownOption = stream.readBool();
+        if (! readCount (count)) return false;
+        for (int i = 0; i < count; ++i)
+            record.arguments.add (stream.readString());
+
+        if (! readCount (count)) return false;
+        for (int i = 0; i < count; ++i) {
+            const juce::String name = stream.readString();
+            record.environment.set (name, stream.readString());
+        }
+
+        if (! readCount (count)) return false;
+        for (int i = 0; i < count; ++i) {
+            record.configSources.add (stream.readString());
+            record.configHashes.add ((juce::uint64) stream.readInt64());
+        }
+
+        records.add (record);
+    }
+    return true;
+}
+
+OptionsParser::ReplayResult OptionsParser::replayTrace (const juce::File& traceFile,
+                                                        const std::function<std::unique_ptr<OptionsParser>()>& createParser,
+                                                        const int numThreads, const int numIterations)
+{
+    ReplayResult replay;
+    juce::Array<TraceRecord> records;
+    if (! readTrace (traceFile, records) || records.isEmpty() || numThreads < 1)
+        return replay;
+
+    std::unique_ptr<LatencyHistogram> histogram (new LatencyHistogram());
+    std::atomic<int>  numFailed (0);
+    std::atomic<bool> noParser (false);
+
+    juce::ThreadPool pool (numThreads);
+
+    const juce::int64 replayStart = juce::Time::getHighResolutionTicks();
+    forEachConcurrently (pool, numThreads, [&] (const int thread) {
+        // the replayed parses don't belong to the statistics of this process
+        const ScopedLatencyPause pause;
+
+        for (int iteration = 0; iteration < numIterations && ! noParser; ++iteration) {
+            for (int i = thread; i < records.size() && ! noParser; i += numThreads) {
+                // a fresh parser for each parse, like the traced tool had. Only the parse is measured
+                std::unique_ptr<OptionsParser> parser (createParser());
+                if (parser == nullptr) {
+                    noParser = true;
+                    break;
+                }
+
+                const juce::int64 parseStart = juce::Time::getHighResolutionTicks();
+                const ParseResult result = parser->parseIntoOptions (records.getReference (i).arguments,
+                                                                     records.getReference (i).failOnUnknownOption, false);
+                const juce::int64 ticks = juce::Time::getHighResolutionTicks() - parseStart;
+                histogram->record ((juce::uint64) (juce::Time::highResolutionTicksToSeconds (ticks) * 1.0e9));
+
+                if (! result.wasOk())
+                    ++numFailed;
+            }
+        }
+    });
+    const juce::int64 replayTicks = juce::Time::getHighResolutionTicks() - replayStart;
+
+    if (noParser)
+        return ReplayResult();
+
+    // measured around all threads, so contention and scheduling show in the throughput
+    replay.seconds         = juce::Time::highResolutionTicksToSeconds (replayTicks);
+    replay.numParses       = records.size() * numIterations;
+    replay.numFailed       = numFailed;
+    replay.numThreads      = numThreads;
+    replay.parsesPerSecond = replay.seconds > 0.0 ? replay.numParses / replay.seconds : 0.0;
+    replay.latency         = histogram->getStats();
+    return replay;
+}
+
+juce::String OptionsParser::SlowParse::toString () const
+{
+    static const char* const phaseNames [numParsePhases] = { "index", "arguments", "arrays", "validation" };
+
+    juce::String text = time.toISO8601 (true) + " slow parse " + juce::String (milliseconds, 3) + " ms ("
+                      + juce::String::toHexString ((juce::int64) schemaFingerprint) + ")";
+    for (int phase = 0; phase < numParsePhases; ++phase)
+        text += juce::String (" ") + phaseNames [phase] + " " + juce::String (phaseMilliseconds [phase], 3) + " ms";
+
+    return text + ": " + arguments.joinIntoString (" ");
+}
+
+void OptionsParser::mapBinaryArrays (ParseResult& result, const bool buildMessages)
+{
+    for (Option* o : options) {
+        if (o->type == OptBinaryArray && ! o->value.isVoid() && ! o->mapFile()) {
+            report (result, InvalidArrayFile, -1, o->optionId, false, buildMessages);
+        }
+    }
+}
+
+void OptionsParser::setValue (ValueSink& sink, ParseResult& result, const int slot, const int position,
+                              const juce::String& text, const bool buildMessages)
+{
+    if (options.getUnchecked (slot)->isValidValue (text)) {
+        sink.setValue (slot, text);
+    }
+    else {
+        FILMSTRO_PROBE2 (conversion__error, slot, text.toRawUTF8());
+        report (result, InvalidValue, position, options.getUnchecked (slot)->optionId, false, buildMessages);
+    }
+}
+
+void OptionsParser::runValidators (ParseResult& result, const bool buildMessages)
+{
+    juce::Array<int> slots;
+    for (int slot = 0; slot < options.size(); ++slot) {
+        const Option* o = options.getUnchecked (slot);
+        if (o->hasValidator() && o->getSource() != SourceDefault)
+            slots.add (slot);
+    }
+
+    if (slots.isEmpty())
+        return;
+
+    std::shared_ptr<ValidationState> state = std::make_shared<ValidationState> (slots.size());
+    for (int i = 0; i < slots.size(); ++i) {
+        // the job works on a copy of the option, the parser might be gone when it finishes
+        std::shared_ptr<Option> copy = std::make_shared<Option> (options.getUnchecked (slots [i])->optionId);
+        copy->type      = options.getUnchecked (slots [i])->type;
+        copy->value     = options.getUnchecked (slots [i])->value;
+        copy->access    = options.getUnchecked (slots [i])->access;
+        copy->validator = options.getUnchecked (slots [i])->validator;
+
+        getValidatorPool().addJob ([state, copy, i] {
+            const juce::String error = copy->validate();
+            {
+                const juce::SpinLock::ScopedLockType sl (state->lock);
+                state->errors.set (i, error);
+                state->finished.set (i, true);
+            }
+            if (--state->remaining == 0)
+                state->done.signal();
+        });
+    }
+
+    state->done.wait (limits.maxValidationMilliseconds > 0 ? limits.maxValidationMilliseconds : -1);
+
+    const juce::SpinLock::ScopedLockType sl (state->lock);
+    for (int i = 0; i < slots.size(); ++i) {
+        const Option* o = options.getUnchecked (slots [i]);
+        if (! state->finished [i]) {
+            report (result, ValidationTimeout, -1, o->optionId, false, buildMessages);
+        }
+        else if (state->errors [i].isNotEmpty()) {
+            report (result, ValidationFailed, -1, o->optionId, false, false);
+            if (buildMessages)
+                appendErrorMessage (describeError (ValidationFailed, o->optionId, false) + ": " + state->errors [i]);
+        }
+    }
+}
+
+OptionsParser::CompactResult OptionsParser::parseArgumentsCompact (const juce::StringArray& arguments,
+                                                                   const bool failOnUnknownOption)
+{
+    const ScopedLatency latency (OperationParse);
+    errorMessage.clear();
+    CompactResult compact;
+    compact.parser = this;
+
+    // the flags are kept between parses, so only a changed schema allocates here
+    compactSetFlags.resize (options.size());
+    compactSetFlags.fill (false);
+
+    CountingSink counter (compactSetFlags);
+    compact.result = parse (arguments, failOnUnknownOption, false, counter);
+    if (! compact.result.wasOk() || counter.numValues == 0)
+        return compact;
+
+    const size_t entriesSize = sizeof (CompactResult::Entry) * (size_t) counter.numValues;
+    compact.block.malloc (entriesSize + counter.numBytes);
+
+    CompactResult::Entry* entries = reinterpret_cast<CompactResult::Entry*> (compact.block.get());
+    char*                 strings = compact.block.get() + entriesSize;
+
+    compactSetFlags.fill (false);
+    FillingSink filler (compactSetFlags, entries, strings);
+    parse (arguments, failOnUnknownOption, false, filler);
+    jassert (filler.numValues == counter.numValues && filler.offset == counter.numBytes);
+
+    // each slot is set only once, so sorted entries allow a binary search
+    std::sort (entries, entries + filler.numValues,
+               [] (const CompactResult::Entry& a, const CompactResult::Entry& b) { return a.slot < b.slot; });
+
+    compact.entries   = entries;
+    compact.strings   = strings;
+    compact.numValues = filler.numValues;
+    return compact;
+}
+
+int OptionsParser::getSlot (juce::StringRef optId) const
+{
+    return idIndex.find (optId);
+}
+
+OptionsParser::Handle OptionsParser::getHandle (juce::StringRef optId) const
+{
+    Handle handle;
+    handle.slot = idIndex.find (optId);
+    jassert (handle.slot >= 0); // there is no option with this id
+    return handle;
+}
+
+OptionsParser::ParseResult OptionsParser::parse (const juce::StringArray& arguments,
+                                                 const bool failOnUnknownOption,
+                                                 const bool buildMessages,
+                                                 ValueSink& sink)
+{
+    ParseResult result;
+    errorToken [0] = 0;
+    FILMSTRO_PROBE1 (parse__start, arguments.size());
+
+    int limitPosition;
+    const ParseError limitError = checkLimits (arguments, limitPosition);
+    if (limitError != NoError) {
+        // the offending argument is not quoted, it might be huge
+        report (result, limitError, limitPosition, juce::String(), false, buildMessages);
+        return result;
+    }
+
+    updateIndex();
+
+    bool endOfArguments = false;
+
+    for (int pos = 0; pos < arguments.size(); ++pos) {
+        if (arguments [pos] == "--") {
+            endOfArguments = true;
+            continue;
+        }
+        const int equals = (! endOfArguments && arguments [pos].startsWith ("--")) ? arguments [pos].indexOfChar ('=') : -1;
+        if (equals > 2) {
+            // --longArg=value
+            const int slot = findSlot (arguments [pos].substring (0, equals), false, sink);
+            FILMSTRO_PROBE2 (option__resolved, slot, arguments [pos].toRawUTF8());
+            if (slot < 0)
+                report (result, UnknownOption, pos, arguments [pos], ! failOnUnknownOption, buildMessages);
+            else if (! sink.isSet (slot) && equals + 1 == arguments [pos].length()
+                     && options.getUnchecked (slot)->type == OptionsParser::OptBoolean)
+                sink.setFlag (slot); // --flag= is the same as --flag
+            else if (! sink.isSet (slot))
+                setValue (sink, result, slot, pos, arguments [pos].substring (equals + 1), buildMessages);
+            continue;
+        }
+
+        const int slot = findSlot (arguments [pos], endOfArguments, sink);
+        if (slot >= 0) {
+            FILMSTRO_PROBE2 (option__resolved, slot, arguments [pos].toRawUTF8());
+            const Option* option = options.getUnchecked (slot);
+            if (option->arg.isEmpty() && option->longArg.isEmpty()) {
+                setValue (sink, result, slot, pos, arguments [pos], buildMessages);
+            }
+            else if (! sink.isSet (slot)) {
+                if (option->type == OptionsParser::OptBoolean) {
+                    sink.setFlag (slot);
+                }
+                else if (pos + 1 < arguments.size()) {
+                    ++pos;
+                    setValue (sink, result, slot, pos, arguments [pos], buildMessages);
+                }
+                else {
+                    report (result, option->type == OptionsParser::OptFile ? MissingPath : MissingValue,
+                            pos, arguments [pos], false, buildMessages);
+                }
+            }
+        }
+        else {
+            report (result, UnknownOption, pos, arguments [pos], ! failOnUnknownOption, buildMessages);
+        }
+    }
+
+    // check if all requireds are met
+    for (int slot = 0; slot < options.size(); ++slot) {
+        const Option* o = options.getUnchecked (slot);
+        if (o->required && !sink.isSet (slot) && o->getSource() != SourceConfig) {
+            report (result, MissingRequired, -1, o->optionId, false, buildMessages);
+        }
+    }
+
+    FILMSTRO_PROBE2 (parse__end, arguments.size(), result.numErrors);
+    return result;
+}
+
+void OptionsParser::report (ParseResult& result, const ParseError error, const int position,
+                            const juce::String& token, const bool isWarning, const bool buildMessages)
+{
+    FILMSTRO_PROBE2 (parse__error, (int) error, position);
+
+    if (isWarning) {
+        ++result.numWarnings;
+    }
+    else {
+        if (result.error == NoError) {
+            result.error    = error;
+            result.position = position;
+            token.copyToUTF8 (errorToken, sizeof (errorToken));
+        }
+        ++result.numErrors;
+    }
+
+    if (buildMessages)
+        appendErrorMessage (describeError (error, token, isWarning));
+}
+
+juce::String OptionsParser::describeError (const ParseError error, const juce::String& token, const bool isWarning) const
+{
+    switch (error) {
+        case UnknownOption:
+            return (isWarning ? "Ignoring unknown option: " : "Unknown option: ") + token;
+        case MissingValue:
+            return "Missing value for argument " + token;
+        case MissingPath:
+            return "Missing path for argument " + token;
+        case MissingRequired:
+            if (const Option* o = getOption (token))
+                return "Argument is required: " + o->getOptionName ();
+            return "Argument is required: " + token;
+        case InvalidArrayFile:
+            if (const Option* o = getOption (token))
+                return "Cannot map " + o->value.toString() + " as array for argument " + o->getOptionName ();
+            return "Cannot map array for argument " + token;
+        case TooManyArguments:
+            return "Too many arguments (limit is " + String (limits.maxTokens) + ")";
+        case ArgumentTooLong:
+            return "Argument is too long (limit is " + String (limits.maxTokenLength) + " bytes)";
+        case ArgumentsTooLong:
+            return "Arguments are too long (limit is " + String (limits.maxTotalBytes) + " bytes)";
+        case InvalidValue:
+            if (const Option* o = getOption (token)) {
+                const bool isNumber = o->type == OptInteger || o->type == OptDouble;
+                return "Invalid value for argument " + o->getOptionName ()
+                     + (isNumber ? " (expected " + String (o->minimum) + " to " + String (o->maximum) + ")"
+                                 : " (expected " + o->pattern + ")");
+            }
+            return "Invalid value for argument " + token;
+        case ValidationFailed:
+            if (const Option* o = getOption (token))
+                return "Invalid value for argument " + o->getOptionName ();
+            return "Invalid value for argument " + token;
+        case ValidationTimeout:
+            if (const Option* o = getOption (token))
+                return "Validation timed out for argument " + o->getOptionName ();
+            return "Validation timed out for argument " + token;
+        default:
+            return String();
+    }
+}
+
+const char* OptionsParser::getErrorToken () const noexcept
+{
+    return errorToken;
+}
+
+void OptionsParser::setLatencyStatsEnabled (const bool enabled) noexcept
+{
+    latencyStatsEnabled.store (enabled);
+}
+
+OptionsParser::LatencyStats OptionsParser::getLatencyStats (const Operation operation)
+{
+    jassert (juce::isPositiveAndBelow ((int) operation, (int) numOperations));
+    return getLatencyHistogram (operation).getStats();
+}
+
+void OptionsParser::resetLatencyStats () noexcept
+{
+    for (int operation = 0; operation < numOperations; ++operation)
+        getLatencyHistogram ((Operation) operation).reset();
+}
+
+const char* OptionsParser::getErrorDescription (const ParseError error) noexcept
+{
+    switch (error) {
+        case NoError:          return "No error";
+        case UnknownOption:    return "Unknown option";
+        case MissingValue:     return "Missing value";
+        case MissingPath:      return "Missing path";
+        case MissingRequired:  return "Argument is required";
+        case InvalidArrayFile: return "Cannot map array file";
+        case TooManyArguments: return "Too many arguments";
+        case ArgumentTooLong:  return "Argument is too long";
+        case ArgumentsTooLong: return "Arguments are too long";
+        case InvalidValue:     return "Invalid value";
+        case ValidationFailed: return "Validation failed";
+        case ValidationTimeout: return "Validation timed out";
+        default:               return "Unknown error";
+    }
+}
+
+bool OptionsParser::loadConfigFile (const juce::File& file)
+{
+    const ScopedLatency latency (OperationConfig);
+    errorMessage.clear();
+    updateIndex();
+
+    // taken before reading, so a file changing meanwhile isn't cached as the new version
+    const ConfigFileStat stat (file);
+
+    juce::Array<ConfigValue> values;
+    if (readConfigCache (file, stat, values)) {
+        // only configs without sections are cached
+        applyConfigValues (values, file.getFullPathName());
+        applySectionBlocks (juce::Array<SectionBlock*>());
+        return true;
+    }
+
+    ConfigFragment root (file, nullptr);
+    if (readConfigFile (root))
+        readIncludedConfigs (root);
+
+    juce::Array<SectionBlock*> blocks;
+    bool ok = mergeConfigFragment (root, values, blocks);
+    applyConfigValues (values, file.getFullPathName());
+
+    if (! applySectionBlocks (blocks))
+        ok = false;
+
+    // the cache only knows the modification time of the root file and has no sections
+    if (ok && root.includes.isEmpty() && blocks.isEmpty() && ConfigFileStat (file) == stat)
+        writeConfigCache (file, stat, values);
+
+    return ok;
+}
+
+bool OptionsParser::readConfigFile (ConfigFragment& fragment) const
+{
+    const juce::File& file = fragment.file;
+    std::unique_ptr<juce::FileInputStream> fileStream (new juce::FileInputStream (file));
+    if (fileStream->failedToOpen()) {
+        fragment.errors.add ("Cannot open config file " + file.getFullPathName());
+        return fragment.ok = false;
+    }
+
+    if (isGzipStream (*fileStream)) {
+        // the decompressor ends a truncated or corrupt stream like a complete one, so the size is
+        // compared with the trailer, which holds the uncompressed size modulo 2^32
+        const juce::int64 totalLength = fileStream->getTotalLength();
+        juce::uint32 expectedSize = 0;
+        if (totalLength >= 18 && fileStream->setPosition (totalLength - 4))
+            expectedSize = (juce::uint32) fileStream->readInt();
+        fileStream->setPosition (0);
+
+        juce::InputStream* decompressor = new juce::GZIPDecompressorInputStream (fileStream.release(), true,
+                                                                                 juce::GZIPDecompressorInputStream::gzipFormat);
+        PipelinedInputStream pipeline (decompressor, 1 << 20);
+        readConfig (pipeline, file.getFullPathName(), fragment);
+
+        // a load stopped at a too long line didn't read to the end
+        if (pipeline.isExhausted() && (totalLength < 18 || (juce::uint32) pipeline.getPosition() != expectedSize)) {
+            fragment.errors.add ("Truncated or corrupt config file " + file.getFullPathName());
+            fragment.ok = false;
+        }
+        return fragment.ok;
+    }
+
+    return readConfig (*fileStream, file.getFullPathName(), fragment);
+}
+
+void OptionsParser::readIncludedConfigs (ConfigFragment& fragment) const
+{
+    // loading is bound by the depth of the includes, not the number of files
+    juce::Array<ConfigFragment*> level;
+    for (ConfigFragment* include : fragment.includes)
+        level.add (include);
+
+    while (! level.isEmpty()) {
+        if (level.size() == 1) {
+            readConfigFile (*level.getFirst());
+        }
+        else {
+            forEachConcurrently (getConfigPool(), level.size(), [this, &level] (const int i) {
+                readConfigFile (*level.getUnchecked (i));
+            });
+        }
+
+        juce::Array<ConfigFragment*> nextLevel;
+        for (ConfigFragment* parent : level)
+            for (ConfigFragment* include : parent->includes)
+                nextLevel.add (include);
+
+        level.swapWith (nextLevel);
+    }
+}
+
+bool OptionsParser::mergeConfigFragment (const ConfigFragment& fragment, juce::Array<ConfigValue>& values,
+                                         juce::Array<SectionBlock*>& blocks)
+{
+    for (const juce::String& error : fragment.errors)
+        appendErrorMessage (error);
+
+    bool ok = fragment.ok;
+    int  next = 0;
+    int  nextBlock = 0;
+    for (int i = 0; i < fragment.includes.size(); ++i) {
+        const int position = fragment.includePositions.getUnchecked (i);
+        values.addArray (fragment.values, next, position - next);
+        next = position;
+
+        const int blockPosition = fragment.includeBlockPositions.getUnchecked (i);
+        for (; nextBlock < blockPosition; ++nextBlock)
+            blocks.add (fragment.blocks.getUnchecked (nextBlock));
+
+        if (! mergeConfigFragment (*fragment.includes.getUnchecked (i), values, blocks))
+            ok = false;
+    }
+    values.addArray (fragment.values, next, fragment.values.size() - next);
+    for (; nextBlock < fragment.blocks.size(); ++nextBlock)
+        blocks.add (fragment.blocks.getUnchecked (nextBlock));
+
+    return ok;
+}
+
+void OptionsParser::addConfigSection (const juce::String& name, OptionsParser& schema)
+{
+    jassert (&schema != this);
+
+    ConfigSection* section = new ConfigSection();
+    section->name   = name;
+    section->schema = &schema;
+    configSections.add (section);
+}
+
+const juce::Array<OptionsParser::SectionInstance>& OptionsParser::getSectionInstances (const juce::String& name) const
+{
+    for (const ConfigSection* section : configSections)
+        if (section->name == name)
+            return section->instances;
+
+    // this section was not added with addConfigSection
+    jassertfalse;
+    static const juce::Array<SectionInstance> noInstances;
+    return noInstances;
+}
+
+bool OptionsParser::readSectionHeader (const juce::String& header, const juce::String& sourceName,
+                                       const juce::String& location, ConfigFragment& fragment) const
+{
+    fragment.currentBlock = nullptr;
+    fragment.skipSection  = true;
+
+    const int dot = header.lastIndexOfChar ('.');
+    const juce::String number = header.substring (dot + 1);
+    if (dot <= 0 || number.isEmpty() || ! number.containsOnly ("0123456789")) {
+        fragment.errors.add ("Expected [name.number] in " + location);
+        return false;
+    }
+
+    // at most 18 digits fit into int64 without wrapping
+    if (number.length() > 18 || number.getLargeIntValue() > std::numeric_limits<int>::max()) {
+        fragment.errors.add ("Section number out of range in " + location + ": " + number);
+        return false;
+    }
+
+    const juce::String name = header.substring (0, dot);
+    for (int section = 0; section < configSections.size(); ++section) {
+        if (configSections.getUnchecked (section)->name == name) {
+            fragment.currentBlock = new SectionBlock (section, number.getIntValue(), sourceName);
+            fragment.skipSection  = false;
+            fragment.blocks.add (fragment.currentBlock);
+            return true;
+        }
+    }
+
+    fragment.errors.add ("Unknown section in " + location + ": " + name);
+    return false;
+}
+
+void OptionsParser::convertSectionBlock (SectionBlock& block) const
+{
+    const OptionsParser& schema = *configSections.getUnchecked (block.section)->schema;
+
+    for (int i = 0; i < block.lines.size(); ++i) {
+        const juce::String location = block.sourceName + ":" + String (block.lineNumbers.getUnchecked (i));
+
+        juce::String name, value;
+        if (! splitAssignment (block.lines [i], name, value)) {
+            block.errors.add ("Expected name = value in " + location);
+            continue;
+        }
+
+        const int slot = schema.findConfigSlot (name);
+        if (slot < 0) {
+            block.errors.add ("Unknown option in " + location + ": " + name);
+            continue;
+        }
+
+        ConfigValue configValue;
+        configValue.slot = slot;
+        if (! schema.convertConfigValue (slot, value, configValue.value)) {
+            block.errors.add ("Invalid value in " + location + " for " + schema.options.getUnchecked (slot)->optionId + ": " + value);
+            continue;
+        }
+
+        block.values.add (configValue);
+    }
+
+    block.instance = Values (schema);
+    for (const ConfigValue& configValue : block.values)
+        block.instance.setValue (configValue.slot, schema.options.getUnchecked (configValue.slot)->type, configValue.value);
+}
+
+bool OptionsParser::applySectionBlocks (const juce::Array<SectionBlock*>& blocks)
+{
+    // each load replaces the instances of the previous one, blocks of the same instance within
+    // one load are merged
+    for (ConfigSection* section : configSections)
+        section->instances.clearQuick();
+
+    if (blocks.isEmpty())
+        return true;
+
+    for (ConfigSection* section : configSections)
+        section->schema->updateIndex();
+
+    if (blocks.size() == 1) {
+        convertSectionBlock (*blocks.getFirst());
+    }
+    else {
+        forEachConcurrently (getConfigPool(), blocks.size(), [this, &blocks] (const int i) {
+            convertSectionBlock (*blocks.getUnchecked (i));
+        });
+    }
+
+    bool ok = true;
+    for (const SectionBlock* block : blocks) {
+        for (const juce::String& error : block->errors)
+            appendErrorMessage (error);
+
+        if (! block->errors.isEmpty())
+            ok = false;
+
+        ConfigSection&         section = *configSections.getUnchecked (block->section);
+        const OptionsParser&   schema  = *section.schema;
+        SectionInstance* const first   = section.instances.begin();
+        SectionInstance* const last    = section.instances.end();
+        SectionInstance* const found   = std::lower_bound (first, last, block->number,
+                                                           [] (const SectionInstance& instance, const int number) {
+                                                               return instance.number < number;
+                                                           });
+
+        if (found != last && found->number == block->number) {
+            for (const ConfigValue& configValue : block->values)
+                found->values.setValue (configValue.slot, schema.options.getUnchecked (configValue.slot)->type, configValue.value);
+        }
+        else {
+            SectionInstance instance;
+            instance.number = block->number;
+            instance.values = block->instance;
+            section.instances.insert ((int) (found - first), instance);
+        }
+    }
+    return ok;
+}
+
+bool OptionsParser::loadConfig (juce::InputStream& stream, const juce::String& sourceName)
+{
+    const ScopedLatency latency (OperationConfig);
+    errorMessage.clear();
+    updateIndex();
+
+    ConfigFragment root (juce::File(), nullptr);
+    readConfig (stream, sourceName, root);
+    readIncludedConfigs (root);
+
+    juce::Array<ConfigValue>   values;
+    juce::Array<SectionBlock*> blocks;
+    bool ok = mergeConfigFragment (root, values, blocks);
+    applyConfigValues (values, sourceName);
+
+    if (! applySectionBlocks (blocks))
+        ok = false;
+
+    return ok;
+}
+
+bool OptionsParser::loadConfig (const KeyValueSource& source)
+{
+    const ScopedLatency latency (OperationConfig);
+    errorMessage.clear();
+    updateIndex();
+
+    const KeyValueSource::Snapshot snapshot = source.getSnapshot();
+    if (snapshot == nullptr) {
+        appendErrorMessage ("No values fetched from " + source.getSocketPath());
+        return false;
+    }
+
+    bool ok = true;
+    juce::Array<ConfigValue> values;
+    const juce::StringArray& keys = snapshot->getAllKeys();
+    for (int i = 0; i < keys.size(); ++i) {
+        const int slot = findConfigSlot (keys [i]);
+        if (slot < 0) {
+            appendErrorMessage ("Unknown option from " + source.getSocketPath() + ": " + keys [i]);
+            ok = false;
+            continue;
+        }
+
+        ConfigValue configValue;
+        configValue.slot = slot;
+        if (! convertConfigValue (slot, snapshot->getAllValues() [i], configValue.value)) {
+            appendErrorMessage ("Invalid value from " + source.getSocketPath() + " for " + keys [i] + ": " + snapshot->getAllValues() [i]);
+            ok = false;
+            continue;
+        }
+
+        values.add (configValue);
+    }
+
+    applyConfigValues (values, source.getSocketPath());
+    return ok;
+}
+
+/** Turns the events of the JsonReader into config values, converting numbers and
+    strings directly to the type of the option */
+struct OptionsParser::JsonConfigHandler {
+    JsonConfigHandler (OptionsParser& p, const JsonReader& r, const juce::String& source,
+                       juce::Array<ConfigValue>& v)
+      : parser     (p),
+        reader     (r),
+        sourceName (source),
+        values     (v),
+        depth      (0),
+        slot       (-1),
+        ok         (true)
+    {}
+
+    void startObject ()
+    {
+        if (depth == 1)
+            unexpectedValue();
+        ++depth;
+    }
+
+    void startArray ()
+    {
+        if (depth <= 1)
+            unexpectedValue();
+        ++depth;
+    }
+
+    void endObject () { --depth; }
+    void endArray ()  { --depth; }
+
+    void key (const char* utf8, const size_t numBytes)
+    {
+        if (depth != 1)
+            return;
+
+        slot = parser.findConfigSlot (utf8, numBytes);
+        if (slot < 0)
+            error ("Unknown option in " + getLocation() + ": " + juce::String::fromUTF8 (utf8, (int) numBytes));
+    }
+
+    void string (const char* utf8, const size_t numBytes)
+    {
+        if (! isOptionValue())
+            return;
+
+        const juce::String text = juce::String::fromUTF8 (utf8, (int) numBytes);
+        juce::var value;
+        if (parser.convertConfigValue (slot, text, value))
+            add (value);
+        else
+            invalidValue (text);
+    }
+
+    void number (const char* utf8, const size_t numBytes)
+    {
+        if (! isOptionValue())
+            return;
+
+        const juce::CharPointer_UTF8 text (utf8);
+        const Option& option = *parser.options.getUnchecked (slot);
+        const double  number = text.getDoubleValue();
+
+        // integers beyond the range of int would wrap when converted
+        const bool isInvalid = (option.type == OptInteger || option.type == OptDouble)
+                                 && ! (number >= option.minimum && number <= option.maximum);
+        const bool isTooBig  = option.type == OptInteger
+                                 && ! (number >= std::numeric_limits<int>::min() && number <= std::numeric_limits<int>::max());
+
+        // like isNumberText, an integer must not have a fraction or exponent
+        const char* end        = utf8 + numBytes;
+        const bool  isFraction = option.type == OptInteger
+                                   && std::find_if (utf8, end, [] (const char c) { return c == '.' || c == 'e' || c == 'E'; }) != end;
+        if (isInvalid || isTooBig || isFraction) {
+            FILMSTRO_PROBE2 (conversion__error, slot, utf8);
+            invalidValue (juce::String::fromUTF8 (utf8, (int) numBytes));
+            return;
+        }
+
+        switch (option.type) {
+            case OptInteger: add ((int) number); break;
+            case OptDouble:  add (number); break;
+            case OptBoolean: add (number != 0.0); break;
+            default:         string (utf8, numBytes); break;
+        }
+    }
+
+    void boolean (const bool value)
+    {
+        if (! isOptionValue())
+            return;
+
+        if (parser.options.getUnchecked (slot)->type == OptBoolean)
+            add (value);
+        else {
+            FILMSTRO_PROBE2 (conversion__error, slot, value ? "true" : "false");
+            error ("Unexpected boolean in " + getLocation() + " for " + parser.options.getUnchecked (slot)->optionId);
+        }
+    }
+
+    void null ()
+    {
+        // keeps the default
+        if (depth == 0)
+            unexpectedValue();
+    }
+
+    bool wasOk () const noexcept { return ok; }
+
+private:
+    bool isOptionValue ()
+    {
+        if (depth == 0)
+            unexpectedValue();
+        return depth == 1 && slot >= 0;
+    }
+
+    void unexpectedValue ()
+    {
+        if (depth == 0)
+            error ("Expected a JSON object in " + getLocation());
+        else if (slot >= 0)
+            error ("Expected a string, number or boolean in " + getLocation() + " for " + parser.options.getUnchecked (slot)->optionId);
+    }
+
+    void invalidValue (const juce::String& text)
+    {
+        error ("Invalid value in " + getLocation() + " for " + parser.options.getUnchecked (slot)->optionId + ": " + text);
+    }
+
+    void add (const juce::var& value)
+    {
+        ConfigValue configValue;
+        configValue.slot  = slot;
+        configValue.value = value;
+        values.add (configValue);
+    }
+
+    void error (const juce::String& message)
+    {
+        parser.appendErrorMessage (message);
+        ok = false;
+    }
+
+    juce::String getLocation () const
+    {
+        return sourceName + ":" + String (reader.getLineNumber());
+    }
+
+    OptionsParser&            parser;
+    const JsonReader&         reader;
+    const juce::String&       sourceName;
+    juce::Array<ConfigValue>& values;
+    int                       depth;
+    int                       slot;
+    bool                      ok;
+};
+
+template <typename Reader>
+bool OptionsParser::readJsonConfig (Reader& reader, const juce::String& sourceName)
+{
+    juce::Array<ConfigValue> values;
+    JsonConfigHandler handler (*this, reader, sourceName, values);
+
+    if (! reader.read (handler)) {
+        appendErrorMessage (juce::String (reader.getError()) + " in " + sourceName + ":" + String (reader.getLineNumber()));
+        return false;
+    }
+
+    applyConfigValues (values, sourceName);
+    return handler.wasOk();
+}
+
+bool OptionsParser::loadJsonConfigFile (const juce::File& file)
+{
+    const ScopedLatency latency (OperationConfig);
+    errorMessage.clear();
+    updateIndex();
+
+    juce::MemoryMappedFile mapped (file, juce::MemoryMappedFile::readOnly);
+    if (! file.existsAsFile() || (mapped.getData() == nullptr && file.getSize() > 0)) {
+        appendErrorMessage ("Cannot open config file " + file.getFullPathName());
+        return false;
+    }
+
+    JsonReader reader (mapped.getData(), mapped.getSize());
+    return readJsonConfig (reader, file.getFullPathName());
+}
+
+bool OptionsParser::loadJsonConfig (juce::InputStream& stream, const juce::String& sourceName)
+{
+    const ScopedLatency latency (OperationConfig);
+    errorMessage.clear();
+    updateIndex();
+
+    JsonReader reader (stream);
+    return readJsonConfig (reader, sourceName);
+}
+
+void OptionsParser::setConfigCacheDirectory (const juce::File& directory)
+{
+    configCacheDirectory = directory;
+}
+
+juce::uint64 OptionsParser::getSchemaFingerprint () const
+{
+    juce::uint64 hash = stableHash (nullptr, 0);
+    for (const Option* o : options) {
+        const juce::int32 types [2]  = { (juce::int32) o->type, (juce::int32) o->elementType };
+        const double      limits [2] = { o->minimum, o->maximum };
+        hash = stableHash (o->optionId, hash);
+        hash = stableHash (o->arg, hash);
+        hash = stableHash (o->longArg, hash);
+        hash = stableHash (types, sizeof (types), hash);
+        // cached values were checked against the limits when they were written
+        hash = stableHash (limits, sizeof (limits), hash);
+        hash = stableHash (o->pattern, hash);
+    }
+    return hash;
+}
+
+juce::File OptionsParser::getConfigCacheFile (const juce::File& file) const
+{
+    const juce::String& path = file.getFullPathName();
+    const juce::uint64  hash = stableHash (path.toRawUTF8(), path.getNumBytesAsUTF8());
+    return configCacheDirectory.getChildFile (file.getFileName() + "-" + String::toHexString ((juce::int64) hash) + ".optcache");
+}
+
+OptionsParser::ConfigFileStat::ConfigFileStat (const juce::File& file)
+  : size       (file.getSize()),
+    modified   (file.getLastModificationTime().toMilliseconds()),
+    identifier (file.getFileIdentifier())
+{
+}
+
+bool OptionsParser::ConfigFileStat::operator== (const ConfigFileStat& other) const noexcept
+{
+    return size == other.size && modified == other.modified && identifier == other.identifier;
+}
+
+bool OptionsParser::readConfigCache (const juce::File& file, const ConfigFileStat& stat,
+                                     juce::Array<ConfigValue>& values) const
+{
+    if (configCacheDirectory == juce::File())
+        return false;
+
+    const juce::File cacheFile = getConfigCacheFile (file);
+    if (! cacheFile.existsAsFile() || ! file.existsAsFile())
+        return false;
+
+    juce::MemoryMappedFile mapped (cacheFile, juce::MemoryMappedFile::readOnly);
+    if (mapped.getData() == nullptr)
+        return false;
+
+    BinaryReader reader (mapped.getData(), mapped.getSize());
+    const char* magic = reader.readBytes (8);
+    if (magic == nullptr || memcmp (magic, configCacheMagic, 8) != 0
+        || reader.readInt() != (juce::uint32) configCacheVersion
+        || reader.readInt64() != getSchemaFingerprint()
+        || reader.readInt64() != (juce::uint64) stat.size
+        || reader.readInt64() != (juce::uint64) stat.modified
+        || reader.readInt64() != stat.identifier)
+        return false;
+
+    const juce::String& path     = file.getFullPathName();
+    const juce::uint32  numBytes = reader.readInt();
+    const char*         bytes    = reader.readBytes (numBytes);
+    if (bytes == nullptr || numBytes != path.getNumBytesAsUTF8() || memcmp (bytes, path.toRawUTF8(), numBytes) != 0)
+        return false;
+
+    const juce::uint32 numValues = reader.readInt();
+    juce::Array<ConfigValue> cached;
+    for (juce::uint32 i = 0; i < numValues && ! reader.hasFailed(); ++i) {
+        ConfigValue configValue;
+        configValue.slot  = (int) reader.readInt();
+        configValue.value = reader.readValue();
+        if (configValue.slot < 0 || configValue.slot >= options.size())
+            return false;
+
+        cached.add (configValue);
+    }
+
+    if (reader.hasFailed())
+        return false;
+
+    values.swapWith (cached);
+    return true;
+}
+
+template <typename Writer>
+void OptionsParser::writeConfigJsonTo (Writer& writer) const
+{
+    writer.writeByte ('{');
+    for (int slot = 0; slot < options.size(); ++slot) {
+        const Option* o = options.getUnchecked (slot);
+        if (slot > 0) writer.writeByte (',');
+        writeJsonString (writer, o->optionId);
+        writeText (writer, ":{\"value\":");
+        writeJsonValue (writer, o->value);
+        writeText (writer, ",\"source\":\"");
+        writeText (writer, getSourceName (o->getSource()));
+        writeText (writer, o->isOptionSet() ? "\",\"set\":true}" : "\",\"set\":false}");
+    }
+    writer.writeByte ('}');
+}
+
+template <typename Writer>
+void OptionsParser::writeConfigBinaryTo (Writer& writer) const
+{
+    writer.write (configValuesMagic, 8);
+    writer.writeInt (options.size());
+    for (const Option* o : options) {
+        writer.writeInt ((int) o->optionId.getNumBytesAsUTF8());
+        writer.write (o->optionId.toRawUTF8(), o->optionId.getNumBytesAsUTF8());
+        writer.writeByte ((char) o->getSource());
+        writer.writeByte (o->isOptionSet() ? 1 : 0);
+        writeBinaryValue (writer, o->value);
+    }
+}
+
+bool OptionsParser::writeConfigJson (juce::OutputStream& stream) const
+{
+    StreamWriter writer (stream);
+    writeConfigJsonTo (writer);
+    return writer.wasOk();
+}
+
+size_t OptionsParser::writeConfigJson (char* buffer, const size_t bufferSize) const
+{
+    BufferWriter writer (buffer, bufferSize);
+    writeConfigJsonTo (writer);
+    return writer.getPosition();
+}
+
+bool OptionsParser::writeConfigBinary (juce::OutputStream& stream) const
+{
+    StreamWriter writer (stream);
+    writeConfigBinaryTo (writer);
+    return writer.wasOk();
+}
+
+size_t OptionsParser::writeConfigBinary (char* buffer, const size_t bufferSize) const
+{
+    BufferWriter writer (buffer, bufferSize);
+    writeConfigBinaryTo (writer);
+    return writer.getPosition();
+}
+
+bool OptionsParser::writeConfigSnapshot (const juce::File& file) const
+{
+    const Values values (*this);
+
+    juce::MemoryOutputStream stream;
+    stream.write (configSnapshotMagic, 8);
+    stream.writeInt (configSnapshotVersion);
+    stream.writeInt (options.size());
+    stream.writeInt64 ((juce::int64) getSchemaFingerprint());
+    stream.writeInt64 (0);
+
+    juce::uint64 stringOffset = configSnapshotHeaderSize + configSnapshotEntrySize * (size_t) options.size();
+    for (int slot = 0; slot < options.size(); ++slot) {
+        const Values::Value& value = values.values.getReference (slot);
+        const juce::String&  text  = values.strings [slot];
+        if (stringOffset + text.getNumBytesAsUTF8() + 1 > 0xffffffffULL)
+            return false;
+
+        stream.writeInt64 (value.intValue);
+        stream.writeDouble (value.doubleValue);
+        stream.writeInt ((int) stringOffset);
+        stream.writeInt ((int) text.getNumBytesAsUTF8());
+        // a snapshot is usually written after loading configs, which don't set isOptionSet
+        stream.writeInt (options.getUnchecked (slot)->getSource() != SourceDefault ? 1 : 0);
+        stream.writeInt (0);
+        stringOffset += text.getNumBytesAsUTF8() + 1;
+    }
+
+    for (const juce::String& text : values.strings)
+        stream.write (text.toRawUTF8(), text.getNumBytesAsUTF8() + 1);
+
+    juce::TemporaryFile temp (file);
+    if (! temp.getFile().replaceWithData (stream.getData(), stream.getDataSize())
+        || ! temp.overwriteTargetFileWithTemporary())
+        return false;
+
+   #if JUCE_DEBUG
+    // the values from configs and arguments must read back as set
+    ConfigSnapshot snapshot;
+    if (snapshot.open (file, *this)) {
+        for (int slot = 0; slot < options.size(); ++slot) {
+            Handle handle;
+            handle.slot = slot;
+            jassert (snapshot.isSet (handle) == (options.getUnchecked (slot)->getSource() != SourceDefault));
+        }
+    }
+    else {
+        jassertfalse; // the snapshot just written doesn't open
+    }
+   #endif
+
+    return true;
+}
+
+void OptionsParser::writeConfigCache (const juce::File& file, const ConfigFileStat& stat,
+                                      const juce::Array<ConfigValue>& values) const
+{
+    if (configCacheDirectory == juce::File() || ! configCacheDirectory.createDirectory().wasOk())
+        return;
+
+    const juce::String& path = file.getFullPathName();
+
+    juce::MemoryOutputStream stream;
+    stream.write (configCacheMagic, 8);
+    stream.writeInt (configCacheVersion);
+    stream.writeInt64 ((juce::int64) getSchemaFingerprint());
+    stream.writeInt64 (stat.size);
+    stream.writeInt64 (stat.modified);
+    stream.writeInt64 ((juce::int64) stat.identifier);
+    stream.writeInt ((int) path.getNumBytesAsUTF8());
+    stream.write (path.toRawUTF8(), path.getNumBytesAsUTF8());
+    stream.writeInt (values.size());
+
+    for (const ConfigValue& configValue : values) {
+        stream.writeInt (configValue.slot);
+        writeBinaryValue (stream, configValue.value);
+    }
+
+    // replace the cache atomically, another process might be mapping it right now
+    juce::TemporaryFile temp (getConfigCacheFile (file));
+    if (temp.getFile().replaceWithData (stream.getData(), stream.getDataSize()))
+        temp.overwriteTargetFileWithTemporary();
+}
+
+bool OptionsParser::readConfig (juce::InputStream& stream, const juce::String& sourceName,
+                                ConfigFragment& fragment) const
+{
+    int lineNumber = 0;
+
+    const bool complete = readLines (stream, [&] (const juce::String& text) {
+        if (! readConfigLine (text, sourceName, ++lineNumber, fragment))
+            fragment.ok = false;
+    });
+
+    if (! complete) {
+        fragment.errors.add ("Line too long in " + sourceName + ":" + String (lineNumber + 1));
+        fragment.ok = false;
+    }
+
+    return fragment.ok;
+}
+
+bool OptionsParser::readConfigLine (const juce::String& text, const juce::String& sourceName,
+                                    const int lineNumber, ConfigFragment& fragment) const
+{
+    const juce::String line = text.trim();
+    if (line.isEmpty() || line.startsWithChar ('#') || line.startsWithChar (';'))
+        return true;
+
+    const juce::String location = sourceName + ":" + String (lineNumber);
+    if (line.startsWith ("@include") && (line.length() == 8 || juce::CharacterFunctions::isWhitespace (line [8])))
+        return readConfigInclude (line.substring (8).trim(), location, fragment);
+
+    if (line.startsWithChar ('[') && line.endsWithChar (']'))
+        return readSectionHeader (line.substring (1, line.length() - 1).trim(), sourceName, location, fragment);
+
+    // the error was reported at the section header
+    if (fragment.skipSection)
+        return true;
+
+    // lines of sections are converted later, concurrently
+    if (fragment.currentBlock != nullptr) {
+        fragment.currentBlock->lines.add (line);
+        fragment.currentBlock->lineNumbers.add (lineNumber);
+        return true;
+    }
+
+    juce::String name, value;
+    if (! splitAssignment (line, name, value)) {
+        fragment.errors.add ("Expected name = value in " + location);
+        return false;
+    }
+
+    const int slot = findConfigSlot (name);
+    if (slot < 0) {
+        fragment.errors.add ("Unknown option in " + location + ": " + name);
+        return false;
+    }
+
+    ConfigValue configValue;
+    configValue.slot = slot;
+    if (! convertConfigValue (slot, value, configValue.value)) {
+        fragment.errors.add ("Invalid value in " + location + " for " + options.getUnchecked (slot)->optionId + ": " + value);
+        return false;
+    }
+
+    fragment.addValue (configValue);
+    return true;
+}
+
+void OptionsParser::ConfigFragment::addValue (const ConfigValue& value)
+{
+    if (value.slot >= valuePositions.size())
+        valuePositions.insertMultiple (valuePositions.size(), -1, value.slot + 1 - valuePositions.size());
+
+    // an include after the earlier value might set the option as well, then this one must come after it
+    const int previous = valuePositions.getUnchecked (value.slot);
+    if (previous >= 0 && (includePositions.isEmpty() || previous >= includePositions.getLast())) {
+        values.getReference (previous) = value;
+        return;
+    }
+
+    valuePositions.set (value.slot, values.size());
+    values.add (value);
+}
+
+bool OptionsParser::readConfigInclude (const juce::String& path, const juce::String& location,
+                                       ConfigFragment& fragment) const
+{
+    const juce::String unquoted = path.isQuotedString() ? path.unquoted() : path;
+    if (unquoted.isEmpty()) {
+        fragment.errors.add ("Expected a file after @include in " + location);
+        return false;
+    }
+
+    const juce::File directory = fragment.file == juce::File() ? juce::File::getCurrentWorkingDirectory()
+                                                               : fragment.file.getParentDirectory();
+    const juce::File file = directory.getChildFile (unquoted);
+
+    // a symlink or another path can name the same file, so the identifier (the inode on POSIX)
+    // is compared as well
+    const juce::uint64 identifier = file.getFileIdentifier();
+    int depth = 0;
+    for (const ConfigFragment* f = &fragment; f != nullptr; f = f->parent, ++depth) {
+        if (f->file == file || (identifier != 0 && f->file.getFileIdentifier() == identifier)) {
+            fragment.errors.add ("Include cycle in " + location + ": " + file.getFullPathName());
+            return false;
+        }
+    }
+
+    if (depth > maxIncludeDepth) {
+        fragment.errors.add ("Includes nested too deeply in " + location + ": " + file.getFullPathName());
+        return false;
+    }
+
+    fragment.includePositions.add (fragment.values.size());
+    fragment.includeBlockPositions.add (fragment.blocks.size());
+    fragment.includes.add (new ConfigFragment (file, &fragment));
+    return true;
+}
+
+int OptionsParser::findConfigSlot (juce::StringRef name) const
+{
+    const int slot = longArgIndex.find (name);
+    return slot >= 0 ? slot : idIndex.find (name);
+}
+
+int OptionsParser::findConfigSlot (const char* utf8, const size_t numBytes) const
+{
+    const int slot = longArgIndex.find (utf8, numBytes);
+    return slot >= 0 ? slot : idIndex.find (utf8, numBytes);
+}
+
+bool OptionsParser::convertConfigValue (const int slot, const juce::String& text, juce::var& value) const
+{
+    const Option& option = *options.getUnchecked (slot);
+    if (! option.isValidValue (text)) {
+        FILMSTRO_PROBE2 (conversion__error, slot, text.toRawUTF8());
+        return false;
+    }
+
+    switch (option.type) {
+        case OptInteger: value = text.getIntValue(); break;
+        case OptDouble:  value = text.getDoubleValue(); break;
+        case OptBoolean: value = isTrueText (text); break;
+        default:         value = text; break;
+    }
+    return true;
+}
+
+void OptionsParser::applyConfigValues (const juce::Array<ConfigValue>& values, const juce::String& sourceName)
+{
+    FILMSTRO_PROBE2 (config__loaded, sourceName.toRawUTF8(), values.size());
+
+    if (traceStream != nullptr) {
+        juce::uint64 hash = stableHash (nullptr, 0);
+        for (const ConfigValue& configValue : values) {
+            hash = stableHash (&configValue.slot, sizeof (configValue.slot), hash);
+            hash = stableHash (configValue.value.toString(), hash);
+        }
+        traceConfigSources.add (sourceName);
+        traceConfigHashes.add (hash);
+    }
+
+    // the help shows the defaults
+    invalidateHelpSections();
+
+    for (const ConfigValue& configValue : values)
+        options.getUnchecked (configValue.slot)->setConfigValue (configValue.value);
+}
+
+void OptionsParser::appendErrorMessage (const juce::StringRef message)
+{
+    if (errorMessage.isNotEmpty()) errorMessage += NewLine();
+    errorMessage += message;
+}
+
+juce::String OptionsParser::getErrorMessage () const
+{
+    return errorMessage;
+}
+
+bool OptionsParser::isOptionSet  (juce::StringRef optId) const
+{
+    if (const Option* o = getOption (optId)) {
+        return o->isOptionSet ();
+    }
+    return false;
+}
+
+juce::String OptionsParser::getOptString (juce::StringRef optId) const
+{
+    if (const Option* o = getOption (optId))
+        return o->value;
+    return String();
+}
+
+juce::File OptionsParser::getOptFile (juce::StringRef optId) const
+{
+    if (const Option* o = getOption (optId))
+        return File (o->value);
+    return File();
+}
+
+int OptionsParser::getOptInt (juce::StringRef optId) const
+{
+    if (const Option* o = getOption (optId))
+        return o->value;
+    return 0;
+}
+
+double OptionsParser::getOptDouble (juce::StringRef optId) const
+{
+    if (const Option* o = getOption (optId))
+        return o->value;
+    return 0.0;
+}
+
+bool OptionsParser::getOptBoolean (juce::StringRef optId) const
+{
+    if (const Option* o = getOption (optId))
+        return toBoolean (o->value);
+    return false;
+}
+
+OptionsParser::Option* OptionsParser::getOption (juce::StringRef optId)
+{
+    const int slot = idIndex.find (optId);
+    return slot < 0 ? nullptr : options.getUnchecked (slot);
+}
+
+const OptionsParser::Option* OptionsParser::getOption   (juce::StringRef optId) const
+{
+    const int slot = idIndex.find (optId);
+    return slot < 0 ? nullptr : options.getUnchecked (slot);
+}
+
+OptionsParser::OptionIndex::OptionIndex ()
+  : numUsed (0)
+{
+}
+
+void OptionsParser::OptionIndex::clear ()
+{
+    table.clear();
+    numUsed = 0;
+}
+
+void OptionsParser::OptionIndex::add (const juce::String& key, const int slot)
+{
+    if ((numUsed + 1) * 2 > table.size())
+        grow();
+
+    const size_t       numBytes = key.getNumBytesAsUTF8();
+    const juce::uint64 h        = hash (key.toRawUTF8(), numBytes);
+    const int          mask     = table.size() - 1;
+
+    for (int i = (int) (h & (juce::uint64) mask);; i = (i + 1) & mask) {
+        Entry& e = table.getReference (i);
+        if (e.slot < 0) {
+            e.key      = key;
+            e.numBytes = numBytes;
+            e.hash     = h;
+            e.slot     = slot;
+            ++numUsed;
+            return;
+        }
+        if (e.hash == h && e.numBytes == numBytes && e.key == key)
+            return;
+    }
+}
+
+int OptionsParser::OptionIndex::find (const char* utf8, const size_t numBytes) const
+{
+    if (numUsed == 0)
+        return -1;
+
+    const juce::uint64 h    = hash (utf8, numBytes);
+    const int          mask = table.size() - 1;
+
+    for (int i = (int) (h & (juce::uint64) mask);; i = (i + 1) & mask) {
+        const Entry& e = table.getReference (i);
+        if (e.slot < 0)
+            return -1;
+        if (e.hash == h && e.numBytes == numBytes && memcmp (e.key.toRawUTF8(), utf8, numBytes) == 0)
+            return e.slot;
+    }
+}
+
+int OptionsParser::OptionIndex::find (juce::StringRef key) const
+{
+    return find (key.text.getAddress(), key.text.sizeInBytes() - 1);
+}
+
+juce::uint64 OptionsParser::OptionIndex::hash (const char* utf8, const size_t numBytes)
+{
+    return sipHash24 (getProcessHashKey(), utf8, numBytes);
+}
+
+void OptionsParser::OptionIndex::grow ()
+{
+    juce::Array<Entry> oldTable;
+    oldTable.swapWith (table);
+
+    table.resize (juce::jmax (16, oldTable.size() * 2));
+    numUsed = 0;
+
+    for (const Entry& e : oldTable)
+        if (e.slot >= 0)
+            add (e.key, e.slot);
+}
+
+OptionsParser::CompactResult::CompactResult () noexcept
+  : parser    (nullptr),
+    entries   (nullptr),
+    strings   (nullptr),
+    numValues (0)
+{
+}
+
+bool OptionsParser::CompactResult::wasOk () const noexcept
+{
+    return result.wasOk();
+}
+
+const OptionsParser::ParseResult& OptionsParser::CompactResult::getParseResult () const noexcept
+{
+    return result;
+}
+
+int OptionsParser::CompactResult::getNumValues () const noexcept
+{
+    return numValues;
+}
+
+int OptionsParser::CompactResult::getSlot (const int index) const noexcept
+{
+    jassert (index >= 0 && index < numValues);
+    return entries [index].slot;
+}
+
+juce::StringRef OptionsParser::CompactResult::getValue (const int index) const noexcept
+{
+    jassert (index >= 0 && index < numValues);
+    return juce::CharPointer_UTF8 (strings + entries [index].offset);
+}
+
+int OptionsParser::CompactResult::indexOfSlot (const int slot) const noexcept
+{
+    int start = 0;
+    int end   = numValues;
+    while (start < end) {
+        const int middle = (start + end) / 2;
+        if (entries [middle].slot < slot)
+            start = middle + 1;
+        else
+            end = middle;
+    }
+    return start < numValues && entries [start].slot == slot ? start : -1;
+}
+
+bool OptionsParser::CompactResult::isOptionSet (const int slot) const noexcept
+{
+    return indexOfSlot (slot) >= 0;
+}
+
+juce::StringRef OptionsParser::CompactResult::getValueForSlot (const int slot) const noexcept
+{
+    const int index = indexOfSlot (slot);
+    return index < 0 ? juce::StringRef() : getValue (index);
+}
+
+const char* OptionsParser::CompactResult::findValue (juce::StringRef optId, const Option*& option) const
+{
+    option = nullptr;
+    if (parser == nullptr)
+        return nullptr;
+
+    const int slot = parser->getSlot (optId);
+    if (slot < 0)
+        return nullptr;
+
+    const int index = indexOfSlot (slot);
+    if (index >= 0)
+        return strings + entries [index].offset;
+
+    option = parser->options.getUnchecked (slot);
+    return nullptr;
+}
+
+juce::String OptionsParser::CompactResult::getOptString (juce::StringRef optId) const
+{
+    const Option* option;
+    if (const char* text = findValue (optId, option))
+        return juce::String (juce::CharPointer_UTF8 (text));
+    return option != nullptr ? option->getValueWithoutArguments().toString() : String();
+}
+
+int OptionsParser::CompactResult::getOptInt (juce::StringRef optId) const
+{
+    const Option* option;
+    if (const char* text = findValue (optId, option))
+        return juce::CharPointer_UTF8 (text).getIntValue32();
+    return option != nullptr ? (int) option->getValueWithoutArguments() : 0;
+}
+
+double OptionsParser::CompactResult::getOptDouble (juce::StringRef optId) const
+{
+    const Option* option;
+    if (const char* text = findValue (optId, option))
+        return juce::CharPointer_UTF8 (text).getDoubleValue();
+    return option != nullptr ? (double) option->getValueWithoutArguments() : 0.0;
+}
+
+bool OptionsParser::CompactResult::getOptBoolean (juce::StringRef optId) const
+{
+    const Option* option;
+    if (const char* text = findValue (optId, option))
+        return isTrueText (juce::String (juce::CharPointer_UTF8 (text)));
+    return option != nullptr ? toBoolean (option->getValueWithoutArguments()) : false;
+}
+
+OptionsParser::KeyValueSource::KeyValueSource (const OptionsParser& parser, const juce::String& path, const int timeout)
+  : juce::Thread ("OptionsParser watcher"),
+    socketPath   (path),
+    timeoutMs    (timeout)
+{
+    for (const Option* o : parser.options)
+        keys.add (o->longArg.isNotEmpty() ? o->longArg : o->optionId);
+}
+
+OptionsParser::KeyValueSource::~KeyValueSource ()
+{
+    // each step of the watcher finishes within timeoutMs and checks for the exit in between
+    signalThreadShouldExit();
+    notify();
+    stopThread (timeoutMs + 1000);
+}
+
+bool OptionsParser::KeyValueSource::refresh ()
+{
+#if FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS
+    // one deadline for the whole exchange, the service might answer in many small pieces
+    const juce::uint32 deadline = juce::Time::getMillisecondCounter() + (juce::uint32) timeoutMs;
+    UnixSocketConnection connection (socketPath, deadline);
+    if (! connection.isConnected() || ! connection.send ("GET " + keys.joinIntoString (" ") + "\n", deadline))
+        return false;
+
+    std::shared_ptr<juce::StringPairArray> values = std::make_shared<juce::StringPairArray> (false);
+    juce::String line;
+    for (;;) {
+        if (! connection.readLine (line, deadline))
+            return false;
+        if (line.isEmpty())
+            break;
+
+        const int equals = line.indexOfChar ('=');
+        if (equals > 0)
+            values->set (line.substring (0, equals), line.substring (equals + 1));
+    }
+
+    FILMSTRO_PROBE2 (snapshot__swapped, socketPath.toRawUTF8(), values->size());
+
+    const juce::SpinLock::ScopedLockType lock (snapshotLock);
+    snapshot = values;
+    return true;
+#else
+    jassertfalse; // unix domain sockets are not available on this platform
+    return false;
+#endif
+}
+
+OptionsParser::KeyValueSource::Snapshot OptionsParser::KeyValueSource::getSnapshot () const
+{
+    const juce::SpinLock::ScopedLockType lock (snapshotLock);
+    return snapshot;
+}
+
+void OptionsParser::KeyValueSource::startWatching ()
+{
+    startThread();
+}
+
+const juce::String& OptionsParser::KeyValueSource::getSocketPath () const noexcept
+{
+    return socketPath;
+}
+
+void OptionsParser::KeyValueSource::run ()
+{
+#if FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS
+    while (! threadShouldExit()) {
+        const juce::uint32 deadline = juce::Time::getMillisecondCounter() + (juce::uint32) timeoutMs;
+        UnixSocketConnection connection (socketPath, deadline);
+        if (! connection.isConnected() || ! connection.send ("WATCH\n", deadline)) {
+            wait (1000);
+            continue;
+        }
+
+        if (threadShouldExit())
+            break;
+
+        // values might have changed while we were not connected
+        if (refresh() && onChange)
+            onChange();
+
+        juce::String line;
+        while (! threadShouldExit()) {
+            if (! connection.waitForData (200))
+                continue;
+            if (! connection.readLine (line, juce::Time::getMillisecondCounter() + (juce::uint32) timeoutMs))
+                break;
+            if (line == "CHANGED" && refresh() && onChange)
+                onChange();
+        }
+    }
+#endif
+}
+
+OptionsParser::KeyValueService::KeyValueService (const juce::String& path)
+  : juce::Thread ("OptionsParser service"),
+    socketPath   (path),
+    listenHandle (-1),
+    changed      (false)
+{
+}
+
+OptionsParser::KeyValueService::~KeyValueService ()
+{
+    // the service polls for the exit every 100 ms
+    stopThread (2000);
+
+#if FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS
+    if (listenHandle >= 0) {
+        ::close (listenHandle);
+        ::unlink (socketPath.toRawUTF8());
+    }
+#endif
+}
+
+bool OptionsParser::KeyValueService::start ()
+{
+#if FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS
+    if (listenHandle >= 0)
+        return true;
+
+    sockaddr_un address;
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.getNumBytesAsUTF8() >= sizeof (address.sun_path))
+        return false;
+
+    socketPath.copyToUTF8 (address.sun_path, sizeof (address.sun_path));
+    ::unlink (address.sun_path);
+
+    listenHandle = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listenHandle < 0)
+        return false;
+
+    if (::bind (listenHandle, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0
+          || ::listen (listenHandle, 16) != 0) {
+        ::close (listenHandle);
+        listenHandle = -1;
+        return false;
+    }
+
+    startThread();
+    return true;
+#else
+    jassertfalse; // unix domain sockets are not available on this platform
+    return false;
+#endif
+}
+
+void OptionsParser::KeyValueService::setValue (const juce::String& key, const juce::String& value)
+{
+    {
+        const juce::ScopedLock lock (valuesLock);
+        values.set (key, value);
+    }
+    changed = true;
+}
+
+void OptionsParser::KeyValueService::removeValue (const juce::String& key)
+{
+    {
+        const juce::ScopedLock lock (valuesLock);
+        values.remove (key);
+    }
+    changed = true;
+}
+
+const juce::String& OptionsParser::KeyValueService::getSocketPath () const noexcept
+{
+    return socketPath;
+}
+
+void OptionsParser::KeyValueService::run ()
+{
+#if FILMSTRO_OPTIONS_PARSER_UNIX_SOCKETS
+    juce::OwnedArray<ServiceClient> clients;
+    juce::Array<pollfd>             descriptors;
+
+    while (! threadShouldExit()) {
+        descriptors.clearQuick();
+        pollfd descriptor;
+        descriptor.fd      = listenHandle;
+        descriptor.events  = POLLIN;
+        descriptor.revents = 0;
+        descriptors.add (descriptor);
+        for (const ServiceClient* client : clients) {
+            descriptor.fd = client->handle;
+            descriptors.add (descriptor);
+        }
+
+        if (::poll (descriptors.getRawDataPointer(), (nfds_t) descriptors.size(), 100) < 0)
+            continue;
+
+        // backwards, so removing a client keeps the descriptors of the others in place
+        for (int i = clients.size(); --i >= 0;) {
+            ServiceClient& client = *clients.getUnchecked (i);
+            if (descriptors.getReference (i + 1).revents == 0)
+                continue;
+
+            char data [4096];
+            const ssize_t numRead = ::recv (client.handle, data, sizeof (data), MSG_DONTWAIT);
+            if (numRead <= 0) {
+                clients.remove (i);
+                continue;
+            }
+
+            client.pending += juce::String::fromUTF8 (data, (int) numRead);
+            bool ok = true;
+            for (int newline = client.pending.indexOfChar ('\n'); ok && newline >= 0; newline = client.pending.indexOfChar ('\n')) {
+                const juce::String line = client.pending.substring (0, newline).trim();
+                client.pending = client.pending.substring (newline + 1);
+
+                if (line == "WATCH") {
+                    client.watching = true;
+                }
+                else if (line.startsWith ("GET ")) {
+                    juce::String response;
+                    const juce::StringArray keys = juce::StringArray::fromTokens (line.substring (4), true);
+                    {
+                        const juce::ScopedLock lock (valuesLock);
+                        for (const juce::String& key : keys)
+                            if (values.containsKey (key))
+                                response << key << "=" << values [key] << "\n";
+                    }
+                    ok = client.send (response + "\n");
+                }
+            }
+
+            if (! ok || client.pending.getNumBytesAsUTF8() > UnixSocketConnection::maxLineLength)
+                clients.remove (i);
+        }
+
+        if (changed.exchange (false)) {
+            for (int i = clients.size(); --i >= 0;)
+                if (clients.getUnchecked (i)->watching && ! clients.getUnchecked (i)->send ("CHANGED\n"))
+                    clients.remove (i);
+        }
+
+        if ((descriptors.getReference (0).revents & POLLIN) != 0) {
+            const int handle = ::accept (listenHandle, nullptr, nullptr);
+            if (handle >= 0) {
+                timeval timeout;
+                timeout.tv_sec  = 1;
+                timeout.tv_usec = 0;
+                ::setsockopt (handle, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+               #ifdef SO_NOSIGPIPE
+                const int noSigPipe = 1;
+                ::setsockopt (handle, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof (noSigPipe));
+               #endif
+                clients.add (new ServiceClient (handle));
+            }
+        }
+    }
+#endif
+}
+
+OptionsParser::Values::Values ()
+{
+}
+
+OptionsParser::Values::Values (const OptionsParser& parser)
+{
+    values.ensureStorageAllocated (parser.options.size());
+    for (const Option* o : parser.options) {
+        values.add (makeValue (o->type, o->value, o->isOptionSet()));
+        strings.add (o->value.toString());
+    }
+}
+
+OptionsParser::Values::Value OptionsParser::Values::makeValue (const OptionType type, const juce::var& v, const bool isSet)
+{
+    Value value;
+    value.isSet       = isSet;
+    value.intValue    = type == OptBoolean ? (toBoolean (v) ? 1 : 0) : (juce::int64) v;
+    value.doubleValue = (double) v;
+    return value;
+}
+
+void OptionsParser::Values::setValue (const int slot, const OptionType type, const juce::var& v)
+{
+    values.set (slot, makeValue (type, v, true));
+    strings.set (slot, v.toString());
+}
+
+bool OptionsParser::Values::isOptionSet (const Handle handle) const noexcept
+{
+    return values.getReference (handle.slot).isSet;
+}
+
+juce::int64 OptionsParser::Values::getInt (const Handle handle) const noexcept
+{
+    return values.getReference (handle.slot).intValue;
+}
+
+double OptionsParser::Values::getDouble (const Handle handle) const noexcept
+{
+    return values.getReference (handle.slot).doubleValue;
 }
 
-OptionsParser::Option* OptionsParser::findOption (const juce::String& argument, const bool endOfArguments)
+bool OptionsParser::Values::getBoolean (const Handle handle) const noexcept
 {
-    if (!endOfArguments && argument.startsWith("--")) {
-        for (Option* o : options)
-            if (o->longArg == argument.substring(2))
-                return o;
-    }
-    else if (!endOfArguments && argument.startsWith("-")) {
-        for (Option* o : options)
-            if (o->arg == argument.substring(1))
-                return o;
+    return values.getReference (handle.slot).intValue != 0;
+}
+
+const juce::String& OptionsParser::Values::getString (const Handle handle) const noexcept
+{
+    return strings.getReference (handle.slot);
+}
+
+OptionsParser::ConfigSnapshot::ConfigSnapshot ()
+  : entries  (nullptr),
+    numSlots (0)
+{
+}
+
+bool OptionsParser::ConfigSnapshot::open (const juce::File& file, const OptionsParser& parser)
+{
+    entries  = nullptr;
+    numSlots = 0;
+    mappedFile.reset (new juce::MemoryMappedFile (file, juce::MemoryMappedFile::readOnly));
+
+    const char*  data = static_cast<const char*> (mappedFile->getData());
+    const size_t size = mappedFile->getSize();
+    if (data == nullptr)
+        return false;
+
+    BinaryReader header (data, size);
+    const char* magic = header.readBytes (8);
+    if (magic == nullptr || memcmp (magic, configSnapshotMagic, 8) != 0
+        || header.readInt() != (juce::uint32) configSnapshotVersion
+        || header.readInt() != (juce::uint32) parser.options.size()
+        || header.readInt64() != parser.getSchemaFingerprint()
+        || header.hasFailed()
+        || size < configSnapshotHeaderSize + configSnapshotEntrySize * (size_t) parser.options.size())
+        return false;
+
+    // check the strings once, so reading them needs no checks
+    const char* table = data + configSnapshotHeaderSize;
+    for (int slot = 0; slot < parser.options.size(); ++slot) {
+        const char* entry = table + configSnapshotEntrySize * (size_t) slot;
+        const juce::uint64 offset = juce::ByteOrder::littleEndianInt (entry + 16);
+        const juce::uint64 length = juce::ByteOrder::littleEndianInt (entry + 20);
+        if (offset + length >= size || data [offset + length] != 0)
+            return false;
     }
-    else {
-        for (Option* o : options)
-            if (o->arg.isEmpty() && o->longArg.isEmpty() && !o->isOptionSet()) {
-                // options without arg and optArg we set directly
-                o->setValue (argument);
-                return o;
-            }
+
+    entries  = table;
+    numSlots = parser.options.size();
+    FILMSTRO_PROBE2 (snapshot__mapped, file.getFullPathName().toRawUTF8(), numSlots);
+    return true;
+}
+
+bool OptionsParser::ConfigSnapshot::isOpen () const noexcept
+{
+    return entries != nullptr;
+}
+
+const char* OptionsParser::ConfigSnapshot::getEntry (const Handle handle) const noexcept
+{
+    if (entries == nullptr)
+        return nullptr;
+
+    jassert (juce::isPositiveAndBelow (handle.slot, numSlots));
+    if (! juce::isPositiveAndBelow (handle.slot, numSlots))
+        return nullptr;
+
+    return entries + configSnapshotEntrySize * (size_t) handle.slot;
+}
+
+bool OptionsParser::ConfigSnapshot::isSet (const Handle handle) const noexcept
+{
+    const char* entry = getEntry (handle);
+    return entry != nullptr && juce::ByteOrder::littleEndianInt (entry + 24) != 0;
+}
+
+juce::int64 OptionsParser::ConfigSnapshot::getInt (const Handle handle) const noexcept
+{
+    const char* entry = getEntry (handle);
+    return entry != nullptr ? (juce::int64) juce::ByteOrder::littleEndianInt64 (entry) : 0;
+}
+
+double OptionsParser::ConfigSnapshot::getDouble (const Handle handle) const noexcept
+{
+    const char* entry = getEntry (handle);
+    if (entry == nullptr)
+        return 0.0;
+
+    const juce::uint64 bits = juce::ByteOrder::littleEndianInt64 (entry + 8);
+    double value;
+    memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+bool OptionsParser::ConfigSnapshot::getBoolean (const Handle handle) const noexcept
+{
+    return getInt (handle) != 0;
+}
+
+const char* OptionsParser::ConfigSnapshot::getString (const Handle handle) const noexcept
+{
+    const char* entry = getEntry (handle);
+    return entry != nullptr
+         ? static_cast<const char*> (mappedFile->getData()) + juce::ByteOrder::littleEndianInt (entry + 16)
+         : "";
+}
+
+OptionsParser::Selection::Selection (const int numJobsToUse, const bool selected)
+  : numJobs (numJobsToUse)
+{
+    words.insertMultiple (0, selected ? ~(juce::uint64) 0 : 0, (numJobs + 63) / 64);
+    if (selected && (numJobs & 63) != 0)
+        words.getReference (numJobs / 64) = (((juce::uint64) 1) << (numJobs & 63)) - 1;
+}
+
+int OptionsParser::Selection::getNumJobs () const noexcept
+{
+    return numJobs;
+}
+
+bool OptionsParser::Selection::isSelected (const int job) const noexcept
+{
+    jassert (job >= 0 && job < numJobs);
+    return getBit (words, job);
+}
+
+int OptionsParser::Selection::countSelected () const noexcept
+{
+    int count = 0;
+    for (juce::uint64 word : words)
+        count += juce::countNumberOfBits (word);
+    return count;
+}
+
+juce::Array<int> OptionsParser::Selection::getSelectedJobs () const
+{
+    juce::Array<int> jobs;
+    for (int w = 0; w < words.size(); ++w) {
+        for (juce::uint64 word = words.getReference (w); word != 0; word &= word - 1) {
+            int bit = 0;
+            while (((word >> bit) & 1) == 0)
+                ++bit;
+            jobs.add (w * 64 + bit);
+        }
     }
+    return jobs;
+}
 
-    return nullptr;
+OptionsParser::Selection& OptionsParser::Selection::operator&= (const Selection& other) noexcept
+{
+    jassert (numJobs == other.numJobs);
+    for (int w = 0; w < words.size(); ++w)
+        words.getReference (w) &= other.words.getReference (w);
+    return *this;
 }
 
-juce::String OptionsParser::getHelpText () const
+OptionsParser::Selection& OptionsParser::Selection::operator|= (const Selection& other) noexcept
 {
-    juce::String text (header);
-    for (Option* o : options) {
-        if (text.isNotEmpty()) text += NewLine();
-        text += o->getHelpText();
+    jassert (numJobs == other.numJobs);
+    for (int w = 0; w < words.size(); ++w)
+        words.getReference (w) |= other.words.getReference (w);
+    return *this;
+}
+
+void OptionsParser::Selection::invert () noexcept
+{
+    for (juce::uint64& word : words)
+        word = ~word;
+
+    if ((numJobs & 63) != 0)
+        words.getReference (numJobs / 64) &= (((juce::uint64) 1) << (numJobs & 63)) - 1;
+}
+
+OptionsParser::BatchResult::BatchResult (OptionsParser& parserToUse)
+  : parser  (parserToUse),
+    numJobs (0)
+{
+}
+
+void OptionsParser::BatchResult::createColumns ()
+{
+    for (const Option* o : parser.options) {
+        Column* column = new Column();
+        column->type   = o->type;
+        columns.add (column);
     }
-    if (footer.isNotEmpty()) {
-        if (text.isNotEmpty()) text += NewLine();
-        text += footer;
+}
+
+void OptionsParser::BatchResult::appendValue (Column& column, const juce::var& value)
+{
+    switch (column.type) {
+        case OptInteger: column.ints.add ((juce::int64) value); break;
+        case OptDouble:  column.doubles.add ((double) value); break;
+        case OptBoolean: appendBit (column.flags, numJobs, toBoolean (value)); break;
+        default:         column.codes.add (intern (value.toString())); break;
     }
-    return text;
 }
 
-bool OptionsParser::parseArguments (const juce::StringArray& arguments, const bool failOnUnknownOption)
+void OptionsParser::BatchResult::replaceValue (Column& column, const int job, juce::StringRef text)
 {
-    errorMessage.clear();
-    bool ok = true;
-    bool endOfArguments = false;
+    switch (column.type) {
+        case OptInteger: column.ints.getReference (job)    = juce::String (text).getLargeIntValue(); break;
+        case OptDouble:  column.doubles.getReference (job) = juce::String (text).getDoubleValue(); break;
+        case OptBoolean: setBit (column.flags, job, isTrueText (juce::String (text))); break;
+        default:         column.codes.getReference (job) = intern (text); break;
+    }
+}
 
-    for (int pos = 0; pos < arguments.size(); ++pos) {
-        if (arguments [pos] == "--") {
-            endOfArguments = true;
-            continue;
-        }
-        if (OptionsParser::Option* option = findOption (arguments [pos], endOfArguments)) {
-            if (! option->isOptionSet()) {
-                if (option->type == OptionsParser::OptBoolean) {
-                    option->setValue (true);
-                }
-                else if (option->type == OptionsParser::OptFile) {
-                    if (pos + 1 < arguments.size()) {
-                        option->setValue (arguments [++pos]);
-                    }
-                    else {
-                        appendErrorMessage ("Missing path for argument " + arguments [pos]);
-                        ok = false;
-                    }
-                }
-                else {
-                    if (pos + 1 < arguments.size()) {
-                        option->setValue (arguments [++pos]);
-                    }
-                    else {
-                        appendErrorMessage ("Missing value for argument " + arguments [pos]);
-                        ok = false;
-                    }
-                }
-            }
-        }
-        else {
-            if (failOnUnknownOption) {
-                appendErrorMessage ("Unknown option: " + arguments [pos]);
-                ok = false;
-            }
-            else {
-                appendErrorMessage ("Ignoring unknown option: " + arguments [pos]);
-            }
-        }
+int OptionsParser::BatchResult::intern (juce::StringRef text)
+{
+    const int existing = dictionaryIndex.find (text);
+    if (existing >= 0)
+        return existing;
+
+    const int code = dictionary.size();
+    dictionary.add (text);
+    dictionaryIndex.add (dictionary [code], code);
+    return code;
+}
+
+int OptionsParser::BatchResult::addJob (const juce::StringArray& arguments, const bool failOnUnknownOption)
+{
+    if (columns.isEmpty())
+        createColumns();
+
+    jassert (columns.size() == parser.options.size()); // don't add options while collecting jobs
+
+    const CompactResult compact = parser.parseArgumentsCompact (arguments, failOnUnknownOption);
+    lastParseResult = compact.getParseResult();
+    if (! compact.wasOk())
+        return -1;
+
+    // first append the defaults and config values, then replace the ones from the arguments
+    for (int slot = 0; slot < columns.size(); ++slot) {
+        Column& column = *columns.getUnchecked (slot);
+        appendBit (column.setBits, numJobs, false);
+        appendValue (column, parser.options.getUnchecked (slot)->getValueWithoutArguments());
     }
 
-    // check if all requireds are met
-    for (Option* o : options) {
-        if (o->required && !o->isOptionSet()) {
-            appendErrorMessage ("Argument is required: " + o->getOptionName ());
-            ok = false;
-        }
+    for (int i = 0; i < compact.getNumValues(); ++i) {
+        Column& column = *columns.getUnchecked (compact.getSlot (i));
+        setBit (column.setBits, numJobs, true);
+        replaceValue (column, numJobs, compact.getValue (i));
     }
 
-    return ok;
+    return numJobs++;
 }
 
-void OptionsParser::appendErrorMessage (const juce::StringRef message)
+const OptionsParser::ParseResult& OptionsParser::BatchResult::getLastParseResult () const noexcept
 {
-    if (errorMessage.isNotEmpty()) errorMessage += NewLine();
-    errorMessage += message;
+    return lastParseResult;
 }
 
-juce::String OptionsParser::getErrorMessage () const
+int OptionsParser::BatchResult::getNumJobs () const noexcept
 {
-    return errorMessage;
+    return numJobs;
 }
 
-bool OptionsParser::isOptionSet  (juce::StringRef optId) const
+bool OptionsParser::BatchResult::isOptionSet (const int slot, const int job) const noexcept
 {
-    if (const Option* o = getOption (optId)) {
-        return o->isOptionSet ();
+    jassert (job >= 0 && job < numJobs);
+    return getBit (columns.getUnchecked (slot)->setBits, job);
+}
+
+juce::int64 OptionsParser::BatchResult::getInt (const int slot, const int job) const noexcept
+{
+    const Column& column = *columns.getUnchecked (slot);
+    switch (column.type) {
+        case OptInteger: return column.ints.getReference (job);
+        case OptDouble:  return (juce::int64) column.doubles.getReference (job);
+        case OptBoolean: return getBit (column.flags, job) ? 1 : 0;
+        default:         return 0;
     }
-    return false;
 }
 
-juce::String OptionsParser::getOptString (juce::StringRef optId) const
+double OptionsParser::BatchResult::getDouble (const int slot, const int job) const noexcept
 {
-    if (const Option* o = getOption (optId))
-        return o->value;
-    return String();
+    const Column& column = *columns.getUnchecked (slot);
+    switch (column.type) {
+        case OptInteger: return (double) column.ints.getReference (job);
+        case OptDouble:  return column.doubles.getReference (job);
+        case OptBoolean: return getBit (column.flags, job) ? 1.0 : 0.0;
+        default:         return 0.0;
+    }
 }
 
-juce::File OptionsParser::getOptFile (juce::StringRef optId) const
+bool OptionsParser::BatchResult::getBoolean (const int slot, const int job) const noexcept
 {
-    if (const Option* o = getOption (optId))
-        return File (o->value);
-    return File();
+    const Column& column = *columns.getUnchecked (slot);
+    return column.type == OptBoolean ? getBit (column.flags, job) : getInt (slot, job) != 0;
 }
 
-int OptionsParser::getOptInt (juce::StringRef optId) const
+juce::String OptionsParser::BatchResult::getString (const int slot, const int job) const
 {
-    if (const Option* o = getOption (optId))
-        return o->value;
-    return 0;
+    const Column& column = *columns.getUnchecked (slot);
+    switch (column.type) {
+        case OptInteger: return String (column.ints.getReference (job));
+        case OptDouble:  return String (column.doubles.getReference (job));
+        case OptBoolean: return getBit (column.flags, job) ? "1" : "0";
+        default:         return dictionary [column.codes.getReference (job)];
+    }
 }
 
-double OptionsParser::getOptDouble (juce::StringRef optId) const
+int OptionsParser::BatchResult::getStringCode (const int slot, const int job) const noexcept
 {
-    if (const Option* o = getOption (optId))
-        return o->value;
-    return 0.0;
+    const Column& column = *columns.getUnchecked (slot);
+    jassert (column.codes.size() == numJobs); // not a text option
+    return column.codes [job];
 }
 
-bool OptionsParser::getOptBoolean (juce::StringRef optId) const
+int OptionsParser::BatchResult::getNumDistinctStrings () const noexcept
 {
-    if (const Option* o = getOption (optId))
-        return o->value;
-    return false;
+    return dictionary.size();
 }
 
-OptionsParser::Option* OptionsParser::getOption (juce::StringRef optId)
+OptionsParser::Selection OptionsParser::BatchResult::isSet (const int slot) const
+{
+    Selection selection (numJobs, false);
+    if (numJobs > 0)
+        selection.words = columns.getUnchecked (slot)->setBits;
+    return selection;
+}
+
+OptionsParser::Selection OptionsParser::BatchResult::equals (const int slot, const juce::var& value) const
 {
-    for (OptionsParser::Option* o : options) {
-        if (o->optionId == optId) {
-            return o;
+    Selection selection (numJobs, false);
+    if (numJobs == 0)
+        return selection;
+
+    const Column& column = *columns.getUnchecked (slot);
+    juce::uint64* words  = selection.words.getRawDataPointer();
+
+    switch (column.type) {
+        case OptInteger: {
+            const juce::int64 v = (juce::int64) value;
+            evaluateColumn (column.ints.begin(), numJobs, words, [v] (juce::int64 x) { return x == v; });
+            break;
+        }
+        case OptDouble: {
+            const double v = (double) value;
+            evaluateColumn (column.doubles.begin(), numJobs, words, [v] (double x) { return x == v; });
+            break;
+        }
+        case OptBoolean:
+            selection.words = column.flags;
+            if (! (bool) value)
+                selection.invert();
+            break;
+        default: {
+            // a text that is not in the dictionary can't match any job
+            const int code = dictionaryIndex.find (value.toString());
+            if (code >= 0)
+                evaluateColumn (column.codes.begin(), numJobs, words, [code] (int x) { return x == code; });
+            break;
         }
     }
-    return nullptr;
+    return selection;
 }
 
-const OptionsParser::Option* OptionsParser::getOption   (juce::StringRef optId) const
+OptionsParser::Selection OptionsParser::BatchResult::inRange (const int slot, const double minimum, const double maximum) const
+{
+    Selection selection (numJobs, false);
+    if (numJobs == 0)
+        return selection;
+
+    const Column& column = *columns.getUnchecked (slot);
+    juce::uint64* words  = selection.words.getRawDataPointer();
+
+    if (column.type == OptInteger) {
+        evaluateColumn (column.ints.begin(), numJobs, words,
+                        [minimum, maximum] (juce::int64 x) { return (double) x >= minimum && (double) x <= maximum; });
+    }
+    else if (column.type == OptDouble) {
+        evaluateColumn (column.doubles.begin(), numJobs, words,
+                        [minimum, maximum] (double x) { return x >= minimum && x <= maximum; });
+    }
+    else {
+        jassertfalse; // only numeric options can be queried by range
+    }
+    return selection;
+}
+
+juce::uint64 OptionsParser::BatchResult::getValueBits (const Column& column, const int job) noexcept
 {
-    for (const OptionsParser::Option* o : options) {
-        if (o->optionId == optId) {
-            return o;
+    switch (column.type) {
+        case OptInteger: return (juce::uint64) column.ints.getReference (job);
+        case OptBoolean: return getBit (column.flags, job) ? 1 : 0;
+        case OptDouble: {
+            juce::uint64 bits;
+            memcpy (&bits, &column.doubles.getReference (job), sizeof (bits));
+            return bits;
         }
+        default:         return (juce::uint64) column.codes.getReference (job);
     }
-    return nullptr;
+}
+
+bool OptionsParser::BatchResult::haveEqualConfig (const int job, const int otherJob, const juce::Array<int>& slots) const noexcept
+{
+    for (int slot : slots) {
+        const Column& column = *columns.getUnchecked (slot);
+        if (getValueBits (column, job) != getValueBits (column, otherJob))
+            return false;
+    }
+    return true;
+}
+
+juce::Array<OptionsParser::BatchResult::JobGroup> OptionsParser::BatchResult::groupJobs () const
+{
+    juce::Array<int> slots;
+    for (int slot = 0; slot < columns.size(); ++slot)
+        if (! parser.options.getUnchecked (slot)->perJob)
+            slots.add (slot);
+
+    // small batches are faster without threads
+    const int jobsPerChunk = 4096;
+    const int numChunks    = (numJobs + jobsPerChunk - 1) / jobsPerChunk;
+    std::unique_ptr<juce::ThreadPool> pool;
+    if (numChunks > 1)
+        pool.reset (new juce::ThreadPool (juce::SystemStats::getNumCpus()));
+
+    auto forEach = [&pool] (const int num, const std::function<void (int)>& function) {
+        if (pool != nullptr)
+            forEachConcurrently (*pool, num, function);
+        else
+            for (int i = 0; i < num; ++i)
+                function (i);
+    };
+
+    // fingerprints column by column, each chunk of jobs on its own thread
+    juce::HeapBlock<juce::uint64> fingerprints ((size_t) numJobs);
+    forEach (numChunks, [&] (const int chunk) {
+        const int start = chunk * jobsPerChunk;
+        const int end   = juce::jmin (numJobs, start + jobsPerChunk);
+        for (int job = start; job < end; ++job)
+            fingerprints [job] = 14695981039346656037ULL;
+
+        for (int slot : slots) {
+            const Column& column = *columns.getUnchecked (slot);
+            for (int job = start; job < end; ++job) {
+                juce::uint64 hash = (fingerprints [job] ^ getValueBits (column, job)) * 1099511628211ULL;
+                fingerprints [job] = hash ^ (hash >> 29);
+            }
+        }
+    });
+
+    // distribute the jobs to shards by fingerprint, then group each shard on its own thread
+    const int numShards = pool != nullptr ? pool->getNumThreads() * 4 : 1;
+    juce::Array<juce::Array<int>> shards;
+    shards.resize (numShards);
+    for (int job = 0; job < numJobs; ++job)
+        shards.getReference ((int) (fingerprints [job] % (juce::uint64) numShards)).add (job);
+
+    juce::Array<juce::Array<JobGroup>> shardGroups;
+    shardGroups.resize (numShards);
+    forEach (numShards, [&] (const int shard) {
+        juce::Array<int>&      jobs   = shards.getReference (shard);
+        juce::Array<JobGroup>& groups = shardGroups.getReference (shard);
+
+        // stable, so the jobs of a group stay in ascending order
+        std::stable_sort (jobs.begin(), jobs.end(), [&fingerprints] (const int a, const int b) {
+            return fingerprints [a] < fingerprints [b];
+        });
+
+        for (int i = 0; i < jobs.size();) {
+            const juce::uint64 fingerprint = fingerprints [jobs [i]];
+            const int firstGroup = groups.size();
+            for (; i < jobs.size() && fingerprints [jobs [i]] == fingerprint; ++i) {
+                // different configs might share a fingerprint
+                int group = firstGroup;
+                while (group < groups.size()
+                       && ! haveEqualConfig (groups.getReference (group).jobs.getFirst(), jobs [i], slots))
+                    ++group;
+
+                if (group == groups.size()) {
+                    JobGroup newGroup;
+                    newGroup.fingerprint = fingerprint;
+                    groups.add (newGroup);
+                }
+                groups.getReference (group).jobs.add (jobs [i]);
+            }
+        }
+    });
 
+    juce::Array<JobGroup> groups;
+    for (const juce::Array<JobGroup>& shard : shardGroups)
+        groups.addArray (shard);
+
+    std::sort (groups.begin(), groups.end(), [] (const JobGroup& a, const JobGroup& b) {
+        return a.jobs.getFirst() < b.jobs.getFirst();
+    });
+    return groups;
 }
 
 juce::String OptionsParser::Option::getOptionName () const
@@ -231,14 +4608,19 @@ juce::String OptionsParser::Option::getOptionName () const
 }
 
 juce::String OptionsParser::Option::getHelpText () const
+{
+    return getHelpText (helpText);
+}
+
+juce::String OptionsParser::Option::getHelpText (const juce::String& textToShow) const
 {
     juce::String text;
     arg.isNotEmpty () ? text += "  -" + arg + "  " : text += "      ";
     if (longArg.isNotEmpty ()) text += "--" + longArg;
     text += " " + getVariableName();
 
-    if (helpText.isNotEmpty()) {
-        text = text.paddedRight (' ', 30) + helpText;
+    if (textToShow.isNotEmpty()) {
+        text = text.paddedRight (' ', 30) + textToShow;
     }
     if (! value.isVoid() && ! isSet) {
         text += " (default: " + value.toString() + ")";
@@ -253,6 +4635,7 @@ juce::String OptionsParser::Option::getVariableName () const
         case OptFile:    return "<filename>";
         case OptInteger: return "<number>";
         case OptDouble:  return "<number>";
+        case OptBinaryArray: return "<arrayfile>";
         default:         return String();
     }
 }
@@ -264,11 +4647,143 @@ bool OptionsParser::Option::isOptionSet () const
 
 void OptionsParser::Option::setValue (juce::var v)
 {
-    if (type == OptFile && !File::isAbsolutePath (v.toString())) {
+    if (source != SourceArguments)
+        valueBeforeArguments = value;
+
+    assignValue (v);
+    isSet  = true;
+    source = SourceArguments;
+}
+
+void OptionsParser::Option::setConfigValue (juce::var v)
+{
+    if (isSet)
+        return;
+
+    assignValue (v);
+    source = SourceConfig;
+}
+
+bool OptionsParser::Option::isValidValue (const juce::String& text) const
+{
+    switch (type) {
+        case OptInteger:
+        case OptDouble: {
+            if (! isNumberText (text, type == OptInteger))
+                return false;
+
+            // integers beyond the range of int would wrap when converted
+            const double number = text.getDoubleValue();
+            if (type == OptInteger && (number < std::numeric_limits<int>::min() || number > std::numeric_limits<int>::max()))
+                return false;
+
+            return number >= minimum && number <= maximum;
+        }
+        case OptBoolean:
+            return true;
+        default:
+            return pattern.isEmpty() || text.matchesWildcard (pattern, false);
+    }
+}
+
+bool OptionsParser::Option::hasValidator () const
+{
+    return access != AccessAny || validator != nullptr;
+}
+
+juce::String OptionsParser::Option::validate () const
+{
+    if (access != AccessAny) {
+        const juce::File file (value.toString());
+        if ((access & AccessReadable) != 0 && ! file.hasReadAccess())
+            return "Cannot read " + file.getFullPathName();
+        if ((access & AccessWritable) != 0 && ! file.hasWriteAccess())
+            return "Cannot write " + file.getFullPathName();
+    }
+
+    return validator != nullptr ? validator (value) : juce::String();
+}
+
+OptionsParser::ValueSource OptionsParser::Option::getSource () const
+{
+    return source;
+}
+
+const juce::var& OptionsParser::Option::getValueWithoutArguments () const
+{
+    return source == SourceArguments ? valueBeforeArguments : value;
+}
+
+void OptionsParser::Option::assignValue (const juce::var& v)
+{
+    if ((type == OptFile || type == OptBinaryArray) && !File::isAbsolutePath (v.toString())) {
         value = File::getCurrentWorkingDirectory().getChildFile (v.toString()).getFullPathName();
     }
     else {
         value = v;
     }
-    isSet = true;
+}
+
+bool OptionsParser::Option::mapFile ()
+{
+    // each parse calls this, the file of the last parse stays mapped
+    const juce::String path = value.toString();
+    if (path == mappedPath && elementType == mappedElementType)
+        return isMapped;
+
+    mappedFile.reset();
+    numElements       = 0;
+    mappedPath        = path;
+    mappedElementType = elementType;
+    isMapped          = false;
+
+    const File file (path);
+    if (! file.existsAsFile())
+        return false;
+
+    const juce::int64 numBytes    = file.getSize();
+    const size_t      elementSize = getElementSize (elementType);
+    if (numBytes % (juce::int64) elementSize != 0)
+        return false;
+
+    if (numBytes == 0)
+        return isMapped = true;
+
+    std::shared_ptr<juce::MemoryMappedFile> mapped (new juce::MemoryMappedFile (file, juce::MemoryMappedFile::readOnly));
+    if (mapped->getData() == nullptr || mapped->getSize() != (size_t) numBytes)
+        return false;
+
+    if (((juce::pointer_sized_int) mapped->getData()) % (juce::pointer_sized_int) elementSize != 0)
+        return false;
+
+    mappedFile  = mapped;
+    numElements = (size_t) numBytes / elementSize;
+    return isMapped = true;
+}
+
+const void* OptionsParser::Option::getMappedData () const noexcept
+{
+    return mappedFile != nullptr ? mappedFile->getData() : nullptr;
+}
+
+size_t OptionsParser::Option::getNumElements () const noexcept
+{
+    return numElements;
+}
+
+size_t OptionsParser::Option::getElementSize (const ElementType elementType) noexcept
+{
+    switch (elementType) {
+        case Int8:
+        case UInt8:   return 1;
+        case Int16:
+        case UInt16:  return 2;
+        case Int32:
+        case UInt32:
+        case Float32: return 4;
+        case Int64:
+        case UInt64:
+        case Float64: return 8;
+        default:      return 1;
+    }
 }
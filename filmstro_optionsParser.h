@@ -53,6 +53,24 @@
 
 #include <juce_core/juce_core.h>
 
+//==============================================================================
+/** Config: FILMSTRO_OPTIONS_PARSER_USDT
+    Adds static probes for bpftrace and perf on Linux (needs sys/sdt.h from systemtap-sdt-dev).
+    A probe is a single nop until a tracer attaches. The probes of the provider filmstro_options are:
+    parse__start (numArguments), parse__end (numArguments, numErrors), option__resolved (slot, argument),
+    parse__error (error, position), conversion__error (slot, value), config__loaded (source, numValues),
+    snapshot__swapped (socketPath, numKeys), snapshot__mapped (path, numSlots)
+ */
+#ifndef FILMSTRO_OPTIONS_PARSER_USDT
+ #define FILMSTRO_OPTIONS_PARSER_USDT 0
+#endif
+
+#if defined (__cpp_constinit)
+ #define FILMSTRO_CONSTINIT constinit
+#else
+ #define FILMSTRO_CONSTINIT
+#endif
+
 /**
  This class provides a parser for command line arguments in unix style.
  
@@ -94,33 +112,142 @@
 
  */
 class OptionsParser {
+private:
+    /**
+     Open addressing hash table from a text to an index, e.g. the slot of an option. The hash is keyed
+     with a random per process secret (SipHash-2-4), so crafted texts cannot provoke collisions.
+     */
+    class OptionIndex {
+    public:
+        OptionIndex ();
+
+        void clear ();
+
+        /** Adds a key, if the key exists already, the first slot wins */
+        void add (const juce::String& key, const int slot);
+
+        /** Returns the slot for a key or -1 */
+        int  find (const char* utf8, const size_t numBytes) const;
+        int  find (juce::StringRef key) const;
+
+        static juce::uint64 hash (const char* utf8, const size_t numBytes);
+
+    private:
+        struct Entry {
+            Entry () : numBytes (0), hash (0), slot (-1) {}
+
+            juce::String key;
+            size_t       numBytes;
+            juce::uint64 hash;
+            int          slot;
+        };
+
+        void grow ();
+
+        juce::Array<Entry> table;
+        int                numUsed;
+    };
+
 public:
 
+    OptionsParser ();
+
     enum  OptionType {
         OptString = 0,
         OptFile,
         OptInteger,
         OptDouble,
-        OptBoolean
+        OptBoolean,
+        OptBinaryArray
+    };
+
+    /** Where the value of an option came from */
+    enum ValueSource {
+        SourceDefault = 0,
+        SourceConfig,
+        SourceArguments
+    };
+
+    /** Element types of a raw binary file for OptBinaryArray, stored in native byte order */
+    enum ElementType {
+        Int8 = 0,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Int64,
+        Float32,
+        Float64,
+        UInt64
+    };
+
+    /** A read only view onto the elements of a memory mapped OptBinaryArray */
+    template <typename Type>
+    class ArrayView {
+    public:
+        ArrayView () noexcept : elements (nullptr), numElements (0) {}
+        ArrayView (const Type* e, const size_t n) noexcept : elements (e), numElements (n) {}
+
+        const Type*  data ()  const noexcept { return elements; }
+        const Type*  begin () const noexcept { return elements; }
+        const Type*  end ()   const noexcept { return elements + numElements; }
+        size_t       size ()  const noexcept { return numElements; }
+        bool         isEmpty () const noexcept { return numElements == 0; }
+
+        const Type&  operator[] (const size_t index) const noexcept
+        {
+            jassert (index < numElements);
+            return elements [index];
+        }
+
+    private:
+        const Type*  elements;
+        size_t       numElements;
     };
 
     class Option {
     public:
         Option (juce::String optId)
-          : optionId  (optId),
-            required  (false),
-            mustExist (false),
-            isSet     (false)
+          : optionId          (optId),
+            required          (false),
+            mustExist         (false),
+            elementType       (Float32),
+            minimum           (-std::numeric_limits<double>::max()),
+            maximum           (std::numeric_limits<double>::max()),
+            access            (AccessAny),
+            perJob            (false),
+            sensitive         (false),
+            isSet             (false),
+            source            (SourceDefault),
+            numElements       (0),
+            mappedElementType (elementType),
+            isMapped          (false)
         {}
 
         juce::String optionId;  //< id to look up an option
         juce::String arg;       //< short argument prefixed by "-"
         juce::String longArg;   //< argument prefixed by "--"
         juce::String helpText;  //< a text to explain the option
+        juce::String groupId;   //< the group in the help text, see addGroup
         bool         required;  //< parseArgument will fail, if a required option is not set
         bool         mustExist; //< for filenames
 
         OptionType   type;      //< type of the option
+        ElementType  elementType; //< for OptBinaryArray, the type of the elements in the file
+
+        double       minimum;   //< for numbers, smaller values are rejected while parsing and loading configs
+        double       maximum;   //< for numbers, bigger values are rejected while parsing and loading configs
+        juce::String pattern;   //< for texts and files, a wildcard the value must match while parsing and loading configs, e.g. "*.wav"
+        int          access;    //< for files, FileAccess flags checked after parsing
+        bool         perJob;    //< the option differs for each job, e.g. input and output, see BatchResult::groupJobs
+        bool         sensitive; //< the value is redacted in logged arguments, e.g. passwords and tokens
+
+        /** Checks the value after parsing and returns an error text, or an empty string if it is valid.
+            It runs on a process wide pool concurrently with the other validators, see Limits.
+            A validator must return on its own: one overrunning the time budget isn't stopped and
+            keeps its pool thread busy, which delays the validators of later parses */
+        std::function<juce::String (const juce::var& value)> validator;
 
         /** Returns the readable string how the option shall be set (arg or longArg) */
         juce::String getOptionName () const;
@@ -128,21 +255,598 @@ public:
         /** Returns the helpText prefixed by the optionName in one line */
         juce::String getHelpText () const;
 
+        /** Returns a different text (e.g. a translation) prefixed by the optionName in one line */
+        juce::String getHelpText (const juce::String& text) const;
+
         /** Returns a description of the expected option type */
         juce::String getVariableName () const;
 
         /** After parseArguments check if the option was set by the user */
         bool         isOptionSet () const;
 
+        /** Checks the number format, minimum, maximum and pattern. These are cheap and run for each
+            value while parsing arguments and loading configs */
+        bool         isValidValue (const juce::String& text) const;
+
+        /** Returns true, if there are checks to run after parsing (access or validator) */
+        bool         hasValidator () const;
+
+        /** Runs the checks after parsing and returns an error text, or an empty string */
+        juce::String validate () const;
+
         /** For the parser to set a value and set the isSet flag */
         void         setValue (juce::var v);
 
+        /** For config sources to set a value. It doesn't set the isSet flag and it
+            doesn't override a value set by arguments */
+        void         setConfigValue (juce::var v);
+
+        /** Returns where the current value came from */
+        ValueSource  getSource () const;
+
+        /** Returns the default or config value, ignoring a value set by parseArguments */
+        const juce::var& getValueWithoutArguments () const;
+
         /** Use this before parseArguments to set a default value */
         juce::var    value;
 
+        /** For OptBinaryArray maps the file in value. Returns false, if the file doesn't exist,
+            its size is not a multiple of the element size or the data is not aligned.
+            The mapping is kept, as long as value and elementType don't change */
+        bool         mapFile ();
+
+        /** For OptBinaryArray returns the mapped elements, or nullptr if nothing was mapped */
+        const void*  getMappedData () const noexcept;
+
+        /** For OptBinaryArray returns the number of mapped elements */
+        size_t       getNumElements () const noexcept;
+
+        /** Returns the size in bytes of an element type */
+        static size_t getElementSize (const ElementType elementType) noexcept;
+
     private:
+        void         assignValue (const juce::var& v);
+
         bool         isSet;
+        ValueSource  source;
+        juce::var    valueBeforeArguments; //< value was replaced by the arguments, see getValueWithoutArguments
+
+        // shared, so copies of the option keep the mapping alive
+        std::shared_ptr<const juce::MemoryMappedFile> mappedFile;
+        size_t       numElements;
+        juce::String mappedPath;
+        ElementType  mappedElementType;
+        bool         isMapped;
+
+    };
+
+    /** Flags for Option::access */
+    enum FileAccess {
+        AccessAny      = 0,
+        AccessReadable = 1,
+        AccessWritable = 2
+    };
+
+    /**
+     Limits enforced while reading the arguments, to protect against hostile input.
+     A value of 0 means unlimited.
+     */
+    struct Limits {
+        Limits ()
+          : maxTokens      (0),
+            maxTokenLength (0),
+            maxTotalBytes  (0),
+            maxValidationMilliseconds (0)
+        {}
+
+        int          maxTokens;      //< maximum number of arguments
+        int          maxTokenLength; //< maximum length of a single argument in bytes
+        juce::int64  maxTotalBytes;  //< maximum size of all arguments together in bytes
+        int          maxValidationMilliseconds; //< time for the validators after parsing, unfinished ones are reported
+    };
+
+    /** Operations measured by the latency statistics */
+    enum Operation {
+        OperationParse = 0,     //< parseArguments, tryParseArguments and parseArgumentsCompact
+        OperationConfig,        //< loading configs
+        OperationHelp,          //< rendering and searching the help
+        numOperations
+    };
+
+    /** Latencies of an operation in microseconds. The percentiles are accurate to about 6 % */
+    struct LatencyStats {
+        LatencyStats ()
+          : count   (0),
+            mean    (0.0),
+            minimum (0.0),
+            maximum (0.0),
+            p50     (0.0),
+            p99     (0.0),
+            p999    (0.0)
+        {}
+
+        juce::int64  count;
+        double       mean;
+        double       minimum;
+        double       maximum;
+        double       p50;
+        double       p99;
+        double       p999;
+    };
+
+    /** One parse captured with startTraceCapture */
+    struct TraceRecord {
+        TraceRecord ()
+          : failOnUnknownOption (true)
+        {}
+
+        juce::StringArray     arguments;
+        bool                  failOnUnknownOption; //< as passed to the traced parse
+        juce::StringPairArray environment;   //< the captured environment variables
+        juce::StringArray     configSources; //< configs loaded before this parse
+        juce::Array<juce::uint64> configHashes; //< hash of the values loaded from each config source
+    };
+
+    /** The result of replayTrace */
+    struct ReplayResult {
+        ReplayResult ()
+          : numParses       (0),
+            numFailed       (0),
+            numThreads      (0),
+            seconds         (0.0),
+            parsesPerSecond (0.0)
+        {}
+
+        int          numParses;
+        int          numFailed;
+        int          numThreads;
+        double       seconds;         //< wall clock time of all threads, including createParser
+        double       parsesPerSecond; //< numParses divided by seconds
+        LatencyStats latency;         //< the time of each parse alone
+    };
+
+    /** Phases of parseArguments timed for slow parses */
+    enum ParsePhase {
+        PhaseIndex = 0,         //< updating the lookup index after options changed
+        PhaseArguments,         //< reading the arguments and checking values
+        PhaseArrays,            //< mapping binary array files
+        PhaseValidation,        //< running the validators
+        numParsePhases
+    };
+
+    /** A parse, that took longer than the threshold set with setSlowParseLogging */
+    struct SlowParse {
+        SlowParse ()
+          : schemaFingerprint (0),
+            milliseconds      (0.0)
+        {
+            for (double& phase : phaseMilliseconds)
+                phase = 0.0;
+        }
+
+        /** Returns all information in one line for a log */
+        juce::String toString () const;
+
+        juce::Time        time;
+        juce::StringArray arguments;          //< values of sensitive options are replaced by ***
+        juce::uint64      schemaFingerprint;
+        double            milliseconds;
+        double            phaseMilliseconds [numParsePhases];
+    };
+
+    /** Error codes reported by tryParseArguments */
+    enum ParseError {
+        NoError = 0,
+        UnknownOption,
+        MissingValue,
+        MissingPath,
+        MissingRequired,
+        InvalidArrayFile,
+        TooManyArguments,
+        ArgumentTooLong,
+        ArgumentsTooLong,
+        InvalidValue,
+        ValidationFailed,
+        ValidationTimeout
+    };
+
+    /**
+     Compact outcome of tryParseArguments. It contains the first error, more errors are only counted.
+     */
+    struct ParseResult {
+        ParseResult () noexcept
+          : error       (NoError),
+            position    (-1),
+            numErrors   (0),
+            numWarnings (0)
+        {}
 
+        bool         wasOk () const noexcept { return error == NoError; }
+
+        ParseError   error;       //< the first error that occurred
+        int          position;    //< index of the offending argument, or -1 if it is not tied to an argument
+        int          numErrors;   //< number of errors
+        int          numWarnings; //< number of ignored unknown options
+    };
+
+    /**
+     Result of parseArgumentsCompact. A first pass over the arguments counts the values and
+     their sizes, so all values are stored in one single allocation.
+     It is sparse: only the options set by the arguments are stored, sorted by slot. For the
+     other options the getters return the default or config value of the option in the parser,
+     never a value left by an earlier parseArguments, so the result must not outlive the parser.
+     */
+    class CompactResult {
+    public:
+        CompactResult () noexcept;
+        CompactResult (CompactResult&&) = default;
+        CompactResult& operator= (CompactResult&&) = default;
+
+        bool               wasOk () const noexcept;
+
+        /** The outcome of the parse, values are only stored if the parse succeeded */
+        const ParseResult& getParseResult () const noexcept;
+
+        /** Returns the number of values set by the arguments */
+        int                getNumValues () const noexcept;
+
+        /** Returns the slot of the option (see getSlot) of the value at index */
+        int                getSlot  (const int index) const noexcept;
+
+        /** Returns the text of the value at index. Booleans are "1", files are not made absolute */
+        juce::StringRef    getValue (const int index) const noexcept;
+
+        /** Check if an option was set by the arguments */
+        bool               isOptionSet (const int slot) const noexcept;
+
+        /** Returns the value of an option or an empty string, if it was not set */
+        juce::StringRef    getValueForSlot (const int slot) const noexcept;
+
+        /** Return a text value set by argument or the value in the parser */
+        juce::String       getOptString  (juce::StringRef optId) const;
+
+        /** Return an integer value set by argument or the value in the parser */
+        int                getOptInt     (juce::StringRef optId) const;
+
+        /** Return a float value set by argument or the value in the parser */
+        double             getOptDouble  (juce::StringRef optId) const;
+
+        /** Return a boolean value set by a flag or the value in the parser */
+        bool               getOptBoolean (juce::StringRef optId) const;
+
+    private:
+        friend class OptionsParser;
+
+        struct Entry {
+            int    slot;
+            size_t offset;
+        };
+
+        int indexOfSlot (const int slot) const noexcept;
+
+        /** Returns the value stored for the option, or nullptr and the option from the parser */
+        const char* findValue (juce::StringRef optId, const Option*& option) const;
+
+        const OptionsParser*  parser;
+        juce::HeapBlock<char> block;
+        const Entry*          entries;
+        const char*           strings;
+        int                   numValues;
+        ParseResult           result;
+    };
+
+    /**
+     A set of jobs in a BatchResult, stored as one bit per job
+     */
+    class Selection {
+    public:
+        Selection (const int numJobs, const bool selected);
+
+        int          getNumJobs () const noexcept;
+        bool         isSelected (const int job) const noexcept;
+        int          countSelected () const noexcept;
+
+        /** Returns the indices of all selected jobs */
+        juce::Array<int> getSelectedJobs () const;
+
+        Selection&   operator&= (const Selection& other) noexcept;
+        Selection&   operator|= (const Selection& other) noexcept;
+        void         invert () noexcept;
+
+    private:
+        friend class OptionsParser;
+
+        juce::Array<juce::uint64> words;
+        int                       numJobs;
+    };
+
+    /**
+     Stores the results of many parses by column: numbers in contiguous arrays, booleans and the
+     isSet flags as bitmaps. Text values are interned once per batch in a dictionary and stored as
+     integer codes. Queries evaluate one column for all jobs at once and return a Selection.
+     Options that were not set hold the value of the option in the parser (default or config).
+     */
+    class BatchResult {
+    public:
+        BatchResult (OptionsParser& parser);
+
+        /** Parses the arguments of a job and appends the values. Returns the index of the job,
+            or -1 if parsing failed, in which case the job is not added */
+        int          addJob (const juce::StringArray& arguments, const bool failOnUnknownOption = true);
+
+        /** After addJob failed, this contains the error */
+        const ParseResult& getLastParseResult () const noexcept;
+
+        int          getNumJobs () const noexcept;
+
+        bool         isOptionSet (const int slot, const int job) const noexcept;
+        juce::int64  getInt      (const int slot, const int job) const noexcept;
+        double       getDouble   (const int slot, const int job) const noexcept;
+        bool         getBoolean  (const int slot, const int job) const noexcept;
+        juce::String getString   (const int slot, const int job) const;
+
+        /** For text options returns the dictionary code of the value. Equal texts have equal codes */
+        int          getStringCode (const int slot, const int job) const noexcept;
+
+        /** Returns the number of distinct texts stored in the batch */
+        int          getNumDistinctStrings () const noexcept;
+
+        /** Selects all jobs, where the option was set by the arguments */
+        Selection    isSet   (const int slot) const;
+
+        /** Selects all jobs, where the option has this value */
+        Selection    equals  (const int slot, const juce::var& value) const;
+
+        /** Selects all jobs, where a numeric option is within minimum and maximum (inclusive) */
+        Selection    inRange (const int slot, const double minimum, const double maximum) const;
+
+        /** Jobs with equal values in all options, that are not marked perJob */
+        struct JobGroup {
+            juce::uint64     fingerprint;
+            juce::Array<int> jobs;     //< in ascending order
+        };
+
+        /** Groups the jobs with equal configuration, ordered by their first job. Fingerprints are computed
+            and grouped concurrently for big batches */
+        juce::Array<JobGroup> groupJobs () const;
+
+    private:
+        struct Column {
+            OptionType                type;
+            juce::Array<juce::uint64> setBits;
+            juce::Array<juce::int64>  ints;
+            juce::Array<double>       doubles;
+            juce::Array<juce::uint64> flags;
+            juce::Array<int>          codes;
+        };
+
+        void createColumns ();
+        int  intern (juce::StringRef text);
+        void appendValue (Column& column, const juce::var& value);
+        void replaceValue (Column& column, const int job, juce::StringRef text);
+
+        /** Returns the value of a job as 64 bits, equal values have equal bits */
+        static juce::uint64 getValueBits (const Column& column, const int job) noexcept;
+
+        bool haveEqualConfig (const int job, const int otherJob, const juce::Array<int>& slots) const noexcept;
+
+        OptionsParser&           parser;
+        juce::OwnedArray<Column> columns;
+        juce::StringArray        dictionary;
+        OptionIndex              dictionaryIndex;
+        int                      numJobs;
+        ParseResult              lastParseResult;
+    };
+
+    /** Identifies an option by its slot. Resolve it once with getHandle to read values without lookup */
+    struct Handle {
+        int slot;
+    };
+
+    /**
+     A copy of all option values, converted to their types once and addressed by Handle,
+     so reading a value is a plain array access.
+     */
+    class Values {
+    public:
+        Values ();
+        explicit Values (const OptionsParser& parser);
+
+        bool                isOptionSet (const Handle handle) const noexcept;
+        juce::int64         getInt      (const Handle handle) const noexcept;
+        double              getDouble   (const Handle handle) const noexcept;
+        bool                getBoolean  (const Handle handle) const noexcept;
+        const juce::String& getString   (const Handle handle) const noexcept;
+
+    private:
+        friend class OptionsParser;
+
+        struct Value {
+            juce::int64 intValue;
+            double      doubleValue;
+            bool        isSet;
+        };
+
+        static Value        makeValue (const OptionType type, const juce::var& v, const bool isSet);
+        void                setValue (const int slot, const OptionType type, const juce::var& v);
+
+        juce::Array<Value> values;
+        juce::StringArray  strings;
+    };
+
+    /**
+     A binary snapshot of all option values written by writeConfigSnapshot. The file is memory mapped
+     and values are read in place by slot, nothing is parsed when opening it. The entries follow the
+     slot layout of the schema, so a snapshot only opens with the schema it was written for.
+     */
+    class ConfigSnapshot {
+    public:
+        ConfigSnapshot ();
+
+        /** Maps the snapshot. Returns false, if the file is invalid or was written for a different schema */
+        bool         open (const juce::File& file, const OptionsParser& parser);
+
+        bool         isOpen () const noexcept;
+
+        /** Returns true, if the value was set in the config or on the command line, rather than being the default */
+        bool         isSet      (const Handle handle) const noexcept;
+
+        /** The getters return 0, 0.0, false or "", if the snapshot is not open */
+        juce::int64  getInt     (const Handle handle) const noexcept;
+        double       getDouble  (const Handle handle) const noexcept;
+        bool         getBoolean (const Handle handle) const noexcept;
+
+        /** Returns the value as zero terminated UTF-8 text, which points into the mapped file */
+        const char*  getString  (const Handle handle) const noexcept;
+
+    private:
+        /** Returns nullptr, if the snapshot is not open */
+        const char*  getEntry (const Handle handle) const noexcept;
+
+        std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+        const char*  entries;
+        int          numSlots;
+    };
+
+    /** One instance of a repeated config section, see addConfigSection */
+    struct SectionInstance {
+        int          number;  //< N from [name.N]
+        Values       values;  //< the defaults of the schema with the values of the section, addressed by the schema's handles
+    };
+
+    /**
+     Holds a process wide configuration, which is filled once at startup and read from hot code
+     afterwards. The constructor is constexpr, so a global instance is initialised at compile time
+     and reading it involves no guard like a function local static. In debug builds it asserts,
+     if it is read before initialise was called.
+
+     \code{.cpp}
+     struct AppConfig {
+         int          bufferSize;
+         juce::String device;
+     };
+
+     FILMSTRO_CONSTINIT OptionsParser::GlobalConfig<AppConfig> appConfig;
+
+     // in main after parsing
+     appConfig.initialise ({ options.getOptInt ("buffersize"), options.getOptString ("device") });
+
+     // anywhere later
+     const int bufferSize = appConfig->bufferSize;
+     \endcode
+     */
+    template <typename ConfigType>
+    class GlobalConfig {
+    public:
+        constexpr GlobalConfig () noexcept : storage (), initialised (false) {}
+
+        ~GlobalConfig ()
+        {
+            if (initialised)
+                reinterpret_cast<ConfigType*> (storage)->~ConfigType();
+        }
+
+        /** Call this once before any thread reads the configuration */
+        void initialise (const ConfigType& config)
+        {
+            jassert (! initialised); // the global config must be set only once
+            new (storage) ConfigType (config);
+            initialised = true;
+        }
+
+        bool isInitialised () const noexcept { return initialised; }
+
+        const ConfigType& get () const noexcept
+        {
+            jassert (initialised); // the global config is read before it was initialised
+            return *reinterpret_cast<const ConfigType*> (storage);
+        }
+
+        const ConfigType& operator* ()  const noexcept { return get(); }
+        const ConfigType* operator-> () const noexcept { return &get(); }
+
+    private:
+        alignas (ConfigType) unsigned char storage [sizeof (ConfigType)];
+        bool initialised;
+
+        JUCE_DECLARE_NON_COPYABLE (GlobalConfig)
+    };
+
+    /**
+     Fetches option values from a local key value service over a unix domain socket.
+     All keys of the parser (longArg, or optionId if there is no longArg) are requested at once.
+     The response is kept as snapshot, which is replaced atomically on each refresh.
+
+     The protocol uses lines of text: the client sends "GET key1 key2 ...", the service answers
+     with a line "key=value" for each known key and an empty line. For watching, the client sends
+     "WATCH" on a second connection and the service sends a line "CHANGED" after any change.
+     */
+    class KeyValueSource : private juce::Thread {
+    public:
+        typedef std::shared_ptr<const juce::StringPairArray> Snapshot;
+
+        KeyValueSource (const OptionsParser& parser, const juce::String& socketPath, const int timeoutMs = 2000);
+        ~KeyValueSource ();
+
+        /** Fetches all values in one request. Returns false, if the service can't be reached */
+        bool         refresh ();
+
+        /** Returns the values of the last successful refresh, or nullptr */
+        Snapshot     getSnapshot () const;
+
+        /** Starts a thread, that refreshes the snapshot whenever the service reports a change */
+        void         startWatching ();
+
+        const juce::String& getSocketPath () const noexcept;
+
+        /** Called on the watching thread after the snapshot was replaced */
+        std::function<void()> onChange;
+
+    private:
+        void run () override;
+
+        juce::String      socketPath;
+        juce::StringArray keys;
+        int               timeoutMs;
+
+        juce::SpinLock    snapshotLock;
+        Snapshot          snapshot;
+
+        JUCE_DECLARE_NON_COPYABLE (KeyValueSource)
+    };
+
+    /**
+     A minimal service speaking the protocol of KeyValueSource, e.g. as stand-in for the real
+     daemon in tests. It serves the values set with setValue on a unix domain socket and sends
+     "CHANGED" to the watching clients after each change.
+     */
+    class KeyValueService : private juce::Thread {
+    public:
+        KeyValueService (const juce::String& socketPath);
+        ~KeyValueService ();
+
+        /** Creates the socket, replacing a stale one, and starts serving. Returns false on errors */
+        bool         start ();
+
+        /** Sets a value and notifies the watching clients */
+        void         setValue (const juce::String& key, const juce::String& value);
+
+        /** Removes a value and notifies the watching clients */
+        void         removeValue (const juce::String& key);
+
+        const juce::String& getSocketPath () const noexcept;
+
+    private:
+        void run () override;
+
+        juce::String          socketPath;
+        int                   listenHandle;
+
+        juce::CriticalSection valuesLock;
+        juce::StringPairArray values;
+        std::atomic<bool>     changed;
+
+        JUCE_DECLARE_NON_COPYABLE (KeyValueService)
     };
 
     /** Create an option to be used in the parser */
@@ -151,9 +855,166 @@ public:
     /** Returns a help text for all options */
     juce::String getHelpText () const;
 
-    /** Read arguments and set them into the options. Returns true, if all requirements are met. */
+    /** Use help texts from a catalog file, e.g. for a translation. The catalog is memory mapped only
+        when a help text is rendered. Options not found in the catalog use their helpText.
+        Use File() to switch back to the helpText of the options. */
+    void         setHelpCatalog (const juce::File& catalogFile);
+
+    /** Writes a help catalog for setHelpCatalog. The keys are optionIds, the values the help texts */
+    static bool  writeHelpCatalog (juce::OutputStream& stream, const juce::StringPairArray& helpTexts);
+
+    /** Starts a group in the help text. All options added afterwards belong to this group.
+        An empty groupId doesn't start a group, the options added afterwards have no group again */
+    void         addGroup (const juce::String& groupId, const juce::String& title);
+
+    /** Returns the ids of all groups in the order they were added */
+    juce::StringArray getGroupIds () const;
+
+    /** Returns the help text of one group: the title followed by its options. Use an empty groupId
+        for the options without group. Each group is rendered on the first request and cached
+        until values change. The help functions may be called from several threads at once,
+        the caches are guarded by a lock. */
+    juce::String getGroupHelpText (juce::StringRef groupId) const;
+
+    /** Returns the help lines of the options matching all words of the pattern. A word matches,
+        if a word of optionId, arg, longArg or helpText starts with it (ignoring case).
+        The words are looked up in an index, which is built on the first search. */
+    juce::String searchHelpText (juce::StringRef pattern) const;
+
+    /** Read arguments and set them into the options. Returns true, if all requirements are met.
+        Long arguments can also be given as --longArg=value. A flag given like that is true unless
+        the value is 0, false, no or off, and getOptString returns the value (e.g. --help=buffer).
+        A flag with an empty value (--flag=) is the same as --flag. */
     bool         parseArguments (const juce::StringArray& arguments, const bool failOnUnknownOption = true);
 
+    /** Reads the arguments without changing the options. The values are counted in a first pass and
+        filled into one block of memory in a second pass, so each parse allocates exactly once. */
+    CompactResult parseArgumentsCompact (const juce::StringArray& arguments, const bool failOnUnknownOption = true);
+
+    /** Returns the index of an option, used to address values in a CompactResult, or -1 */
+    int          getSlot      (juce::StringRef optId) const;
+
+    /** Returns a handle to read values of an option from Values. The option must exist */
+    Handle       getHandle    (juce::StringRef optId) const;
+
+    /** Same as parseArguments, but it doesn't create error messages. Instead the first error is
+        returned as code and the offending argument is copied into a preallocated buffer, see
+        getErrorToken. Errors in the arguments never throw, but it is not noexcept: setting values,
+        mapping binary arrays, tracing and slow parse records allocate, and the validators and the
+        slow parse callback are user code. Exceptions from those are passed on to the caller. */
+    ParseResult  tryParseArguments (const juce::StringArray& arguments, const bool failOnUnknownOption = true);
+
+    /** After tryParseArguments this contains the argument (or optionId for missing options) of the first error.
+        It is truncated to fit the buffer and empty, if the error was a violated limit. */
+    const char*  getErrorToken () const noexcept;
+
+    /** Records the latencies of all parsers in the process into log bucketed histograms. Each thread
+        counts into its own shard without locks, the shards are merged when reading the stats.
+        It is off by default, then measuring costs one atomic load per call */
+    static void         setLatencyStatsEnabled (const bool enabled) noexcept;
+
+    static LatencyStats getLatencyStats (const Operation operation);
+
+    static void         resetLatencyStats () noexcept;
+
+    /** Appends the arguments of each parseArguments and tryParseArguments to a trace file, together with
+        the values of some environment variables and hashes of the configs loaded before. Values of
+        sensitive options are written as ***. Returns false, if the file exists and is not a trace.
+        The trace can be replayed with replayTrace to benchmark with real inputs */
+    bool         startTraceCapture (const juce::File& traceFile, const juce::StringArray& environmentVariables = juce::StringArray());
+
+    void         stopTraceCapture ();
+
+    /** Reads all records of a trace file. Returns false, if the file is no trace or truncated */
+    static bool  readTrace (const juce::File& traceFile, juce::Array<TraceRecord>& records);
+
+    /** Parses all arguments of a trace numIterations times like parseArguments, on numThreads threads
+        at once. createParser is called for each parse and must return a fresh parser with the options
+        of the traced application. The latency is measured for each parse alone, the throughput from
+        the wall clock time of the whole replay, which includes createParser. If it returns nullptr,
+        the result is empty. Each record is parsed with its traced failOnUnknownOption. The environment
+        and configs are not replayed, and the replayed parses are not added to getLatencyStats */
+    static ReplayResult replayTrace (const juce::File& traceFile,
+                                     const std::function<std::unique_ptr<OptionsParser>()>& createParser,
+                                     const int numThreads = 1, const int numIterations = 1);
+
+    /** Records each parseArguments or tryParseArguments taking longer than thresholdMilliseconds.
+        The last maxRecords slow parses are kept, and onSlowParse is called for each if set, e.g. to log it.
+        A threshold of 0 switches it off (the default) */
+    void         setSlowParseLogging (const double thresholdMilliseconds, const int maxRecords = 32,
+                                      std::function<void (const SlowParse&)> onSlowParse = nullptr);
+
+    /** Returns the recorded slow parses, the oldest first */
+    juce::Array<SlowParse> getSlowParses () const;
+
+    /** Returns a short static description of an error code */
+    static const char* getErrorDescription (const ParseError error) noexcept;
+
+    /** Reads options from a config file with lines of "name = value", where name is the longArg
+        or the optionId. Empty lines and lines starting with # or ; are ignored.
+        A line "@include path" reads another config file at this position, relative paths are
+        resolved from the directory of the including file. All includes of one level are read
+        concurrently, include cycles are reported as error.
+        Config values are used like defaults, they never override values set by arguments.
+        Gzip compressed files are decompressed on a separate thread while the lines are parsed. */
+    bool         loadConfigFile (const juce::File& file);
+
+    /** Reads options from a stream in the config file format. sourceName is used in error messages.
+        Relative includes are resolved from the current working directory */
+    bool         loadConfig   (juce::InputStream& stream, const juce::String& sourceName);
+
+    /** Reads options from a JSON file with one object of "name": value, where name is the longArg
+        or the optionId. The file is memory mapped and read by an event based reader, that converts
+        each value to the type of its option while reading, without building a var tree.
+        A null value keeps the default. */
+    bool         loadJsonConfigFile (const juce::File& file);
+
+    /** Reads options in JSON from a stream, which is read in chunks */
+    bool         loadJsonConfig (juce::InputStream& stream, const juce::String& sourceName);
+
+    /** Applies the current snapshot of a KeyValueSource as config values */
+    bool         loadConfig   (const KeyValueSource& source);
+
+    /** Declares repeated sections "[name.N]" in config files, e.g. one per job. The lines of each section
+        are options of the schema and form an independent instance of it. Sections are converted
+        concurrently after reading. Options set in a section are reported as set.
+        The schema must stay alive as long as this parser. */
+    void         addConfigSection (const juce::String& name, OptionsParser& schema);
+
+    /** Returns the instances of a section read from the last loaded config ordered by number. Each
+        loadConfigFile or loadConfig of a text config replaces the instances. Within one config, a
+        section with a number, that was already read (e.g. in an include), overrides values of that instance */
+    const juce::Array<SectionInstance>& getSectionInstances (const juce::String& name) const;
+
+    /** Set a directory to cache parsed config files. loadConfigFile then stores the converted values
+        in a binary file, which is memory mapped and used instead, as long as size, modification time
+        and file identifier of the config and the schema fingerprint are unchanged.
+        Use File() to disable caching (the default). */
+    void         setConfigCacheDirectory (const juce::File& directory);
+
+    /** Writes all current values as a snapshot for ConfigSnapshot, e.g. in a build step after
+        loadConfigFile. The file is replaced atomically */
+    bool         writeConfigSnapshot (const juce::File& file) const;
+
+    /** Returns a hash over ids, args, types and limits of all options. It is stable between processes */
+    juce::uint64 getSchemaFingerprint () const;
+
+    /** Writes the effective configuration as one JSON object in a single pass, without building a var:
+        {"optionId":{"value":...,"source":"default|config|arguments","set":true|false},...} */
+    bool         writeConfigJson (juce::OutputStream& stream) const;
+
+    /** Writes the JSON into a buffer without allocating. Returns the number of bytes needed, if that is
+        bigger than bufferSize the output was truncated. The text is not zero terminated */
+    size_t       writeConfigJson (char* buffer, const size_t bufferSize) const;
+
+    /** Writes the effective configuration in a compact binary form: the magic "OPTVALS1", the number of
+        options, then for each option the length and bytes of the optionId, a byte for the source,
+        a byte for the set flag and the typed value. All numbers are little endian */
+    bool         writeConfigBinary (juce::OutputStream& stream) const;
+
+    /** Writes the binary form into a buffer, returns the number of bytes needed like writeConfigJson */
+    size_t       writeConfigBinary (char* buffer, const size_t bufferSize) const;
+
     /** if parseArguments failed, this will contain a helpful text about bad arguments */
     juce::String getErrorMessage () const;
 
@@ -175,23 +1036,283 @@ public:
     /** Return a boolean value set by a flag */
     bool         getOptBoolean(juce::StringRef optId) const;
 
+    /** Return the elements of a binary array file. Type must match the elementType of the option,
+        otherwise an empty view is returned */
+    template <typename Type>
+    ArrayView<Type> getOptArray (juce::StringRef optId) const
+    {
+        if (const Option* o = getOption (optId)) {
+            if (o->type == OptBinaryArray && o->elementType == elementTypeOf (static_cast<const Type*> (nullptr)))
+                return ArrayView<Type> (static_cast<const Type*> (o->getMappedData()), o->getNumElements());
+
+            jassertfalse; // the option is not a binary array of this type
+        }
+        return ArrayView<Type>();
+    }
+
     /** Returns a pointer to a option instance */
     Option*      getOption    (juce::StringRef optId);
     const Option* getOption   (juce::StringRef optId) const;
 
+    /** Set limits for untrusted input. If they are exceeded, parseArguments fails before any option is set */
+    void         setLimits    (const Limits& newLimits);
+    const Limits& getLimits   () const;
+
+    /** The lookup tables for arg and longArg are built on the first parse after adding options.
+        If you change arg, longArg, helpText or groupId of an existing option afterwards, call this
+        to rebuild them and the cached help texts. A changed value is detected by the help cache. */
+    void         invalidateIndex ();
+
     /** This will be printed before the help text */
     juce::String header;
     /** This will be printed after the help text */
     juce::String footer;
 
 private:
-    OptionsParser::Option* findOption (const juce::String& argument, const bool endOfArguments);
+    /** Selected by size and signedness, so int64_t works whether it is long or long long */
+    template <typename Type>
+    static ElementType elementTypeOf (const Type*) noexcept
+    {
+        static_assert (std::is_arithmetic<Type>::value && sizeof (Type) <= 8, "No element type for this type");
+
+        if (std::is_floating_point<Type>::value)
+            return sizeof (Type) == 4 ? Float32 : Float64;
+
+        const bool isSigned = std::is_signed<Type>::value;
+        switch (sizeof (Type)) {
+            case 1:  return isSigned ? Int8  : UInt8;
+            case 2:  return isSigned ? Int16 : UInt16;
+            case 4:  return isSigned ? Int32 : UInt32;
+            default: return isSigned ? Int64 : UInt64;
+        }
+    }
+
+    void mapBinaryArrays (ParseResult& result, const bool buildMessages);
+
+    /** Parses into the options, shared by parseArguments and tryParseArguments */
+    ParseResult parseIntoOptions (const juce::StringArray& arguments, const bool failOnUnknownOption, const bool buildMessages);
+
+    /** Returns the arguments with the values of sensitive options replaced by ***. It resolves the
+        options on its own, so values are redacted even if the parse failed or skipped them */
+    juce::StringArray redactArguments (const juce::StringArray& arguments) const;
+
+    void recordSlowParse (const juce::StringArray& arguments, const double milliseconds, const double* phaseMilliseconds);
+
+    void writeTraceRecord (const juce::StringArray& arguments, const bool failOnUnknownOption);
+
+    /** Runs the expensive validators concurrently within limits.maxValidationMilliseconds */
+    void runValidators (ParseResult& result, const bool buildMessages);
+
+    /** A value read from a config source, converted to the type of the option */
+    struct ConfigValue {
+        int          slot;
+        juce::var    value;
+    };
+
+    /** A section registered with addConfigSection and its loaded instances */
+    struct ConfigSection {
+        juce::String                 name;
+        OptionsParser*               schema;
+        juce::Array<SectionInstance> instances;
+    };
+
+    /** The lines of one "[name.N]" block, which are converted concurrently after reading */
+    struct SectionBlock {
+        SectionBlock (const int s, const int n, const juce::String& source)
+          : section    (s),
+            number     (n),
+            sourceName (source)
+        {}
+
+        int                      section;
+        int                      number;
+        juce::String             sourceName;
+        juce::StringArray        lines;
+        juce::Array<int>         lineNumbers;
+
+        juce::Array<ConfigValue> values;   //< set by convertSectionBlock
+        Values                   instance; //< set by convertSectionBlock
+        juce::StringArray        errors;
+    };
+
+    /** The values and includes read from one config source. Errors are collected per
+        fragment, so fragments can be read concurrently and still report in order */
+    struct ConfigFragment {
+        ConfigFragment (const juce::File& f, const ConfigFragment* p)
+          : file         (f),
+            parent       (p),
+            currentBlock (nullptr),
+            skipSection  (false),
+            ok           (true)
+        {}
+
+        /** Adds a value, replacing an earlier one of the same option unless an include lies in
+            between. So the memory is bounded by the number of options, not by the size of the file */
+        void addValue (const ConfigValue& value);
+
+        juce::File                       file;     //< File() for streams
+        const ConfigFragment*            parent;   //< the including fragment, to detect cycles
+        juce::Array<ConfigValue>         values;
+        juce::Array<int>                 valuePositions;   //< index in values for each slot, or -1
+        juce::Array<int>                 includePositions; //< number of values read before each include
+        juce::Array<int>                 includeBlockPositions; //< number of section blocks read before each include
+        juce::OwnedArray<ConfigFragment> includes;
+        juce::OwnedArray<SectionBlock>   blocks;
+        SectionBlock*                    currentBlock;
+        bool                             skipSection; //< after an invalid section header
+        juce::StringArray                errors;
+        bool                             ok;
+    };
+
+    bool readConfigFile (ConfigFragment& fragment) const;
+
+    /** Reads the includes of a fragment level by level, all files of one level concurrently */
+    void readIncludedConfigs (ConfigFragment& fragment) const;
+
+    /** Appends the values and section blocks of a fragment with its includes in declaration order */
+    bool mergeConfigFragment (const ConfigFragment& fragment, juce::Array<ConfigValue>& values,
+                              juce::Array<SectionBlock*>& blocks);
+
+    bool readSectionHeader (const juce::String& header, const juce::String& sourceName, const juce::String& location,
+                            ConfigFragment& fragment) const;
+
+    void convertSectionBlock (SectionBlock& block) const;
+
+    /** Converts all blocks concurrently and adds them to the section instances */
+    bool applySectionBlocks (const juce::Array<SectionBlock*>& blocks);
+
+    /** The properties of a config file a cache is valid for */
+    struct ConfigFileStat {
+        ConfigFileStat (const juce::File& file);
+        bool operator== (const ConfigFileStat& other) const noexcept;
+
+        juce::int64  size;
+        juce::int64  modified;
+        juce::uint64 identifier;
+    };
+
+    juce::File getConfigCacheFile (const juce::File& file) const;
+    bool readConfigCache  (const juce::File& file, const ConfigFileStat& stat, juce::Array<ConfigValue>& values) const;
+
+    /** Writes the cache for the values read from the file, stat was taken before reading it */
+    void writeConfigCache (const juce::File& file, const ConfigFileStat& stat, const juce::Array<ConfigValue>& values) const;
+
+    template <typename Writer>
+    void writeConfigJsonTo (Writer& writer) const;
+
+    template <typename Writer>
+    void writeConfigBinaryTo (Writer& writer) const;
+
+    bool readConfig (juce::InputStream& stream, const juce::String& sourceName, ConfigFragment& fragment) const;
+
+    bool readConfigLine (const juce::String& text, const juce::String& sourceName, const int lineNumber,
+                         ConfigFragment& fragment) const;
+
+    bool readConfigInclude (const juce::String& path, const juce::String& location, ConfigFragment& fragment) const;
+
+    int  findConfigSlot (juce::StringRef name) const;
+    int  findConfigSlot (const char* utf8, const size_t numBytes) const;
+
+    struct JsonConfigHandler;
+
+    template <typename Reader>
+    bool readJsonConfig (Reader& reader, const juce::String& sourceName);
+
+    /** Converts the text to the type of the option, returns false if it is not a valid value for it */
+    bool convertConfigValue (const int slot, const juce::String& text, juce::var& value) const;
+
+    void applyConfigValues (const juce::Array<ConfigValue>& values, const juce::String& sourceName);
+
+    struct HelpToken {
+        juce::String     token;
+        juce::Array<int> slots;
+    };
+
+    void buildHelpIndex () const;
+
+    struct Group {
+        juce::String groupId;
+        juce::String title;
+    };
+
+    void invalidateHelpSections () noexcept;
+
+    /** Returns the help text of an option from the catalog, or its helpText */
+    juce::String getCatalogHelpText (const Option& option) const;
+
+    /** Receives the values found while parsing */
+    struct ValueSink {
+        virtual ~ValueSink () {}
+        virtual bool isSet    (const int slot) const = 0;
+        virtual void setValue (const int slot, const juce::String& value) = 0;
+        virtual void setFlag  (const int slot) = 0;
+    };
+
+    struct OptionSink;
+    struct CountingSink;
+    struct FillingSink;
+
+    /** Checks the value of an option inline before it is set */
+    void setValue (ValueSink& sink, ParseResult& result, const int slot, const int position,
+                   const juce::String& text, const bool buildMessages);
+
+    int findSlot (const juce::String& argument, const bool endOfArguments, const ValueSink& sink) const;
+
+    void updateIndex ();
+
+    ParseResult parse (const juce::StringArray& arguments, const bool failOnUnknownOption,
+                       const bool buildMessages, ValueSink& sink);
+
+    ParseError checkLimits (const juce::StringArray& arguments, int& position) const noexcept;
+
+    void report (ParseResult& result, const ParseError error, const int position,
+                 const juce::String& token, const bool isWarning, const bool buildMessages);
+
+    juce::String describeError (const ParseError error, const juce::String& token, const bool isWarning) const;
 
     void appendErrorMessage (const juce::StringRef message);
 
     juce::OwnedArray<Option> options;
 
+    OptionIndex         idIndex;
+    OptionIndex         argIndex;
+    OptionIndex         longArgIndex;
+    juce::Array<int>    positionalSlots;
+    juce::Array<bool>   compactSetFlags;
+    bool                indexIsDirty;
+
+    mutable juce::Array<HelpToken> helpIndex;
+    mutable bool        helpIndexIsDirty;
+
+    juce::Array<Group>  groups;
+    juce::String        currentGroupId;
+    mutable juce::StringArray helpSections;
+    mutable juce::Array<bool> helpSectionIsValid;
+    mutable juce::Array<juce::var> helpValues; //< the value of each option when its section was rendered
+    mutable juce::Array<bool>      helpIsSet;  //< if each option was set when its section was rendered, set options show no default
+    mutable juce::CriticalSection  helpLock;   //< guards the help caches filled by the const help functions
+
+    juce::File          helpCatalogFile;
+    mutable std::unique_ptr<juce::MemoryMappedFile> helpCatalog;
+
+    Limits              limits;
+
+    juce::File          configCacheDirectory;
+    juce::OwnedArray<ConfigSection> configSections;
+
+    double              slowParseThreshold;
+    int                 maxSlowParses;
+    int                 nextSlowParse;
+    juce::Array<SlowParse> slowParses;
+    std::function<void (const SlowParse&)> slowParseCallback;
+
+    std::unique_ptr<juce::FileOutputStream> traceStream;
+    juce::StringArray   traceEnvironment;
+    juce::StringArray   traceConfigSources;
+    juce::Array<juce::uint64> traceConfigHashes;
+
     juce::String        errorMessage;
+    char                errorToken [128];
 };
 
 